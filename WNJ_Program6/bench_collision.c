@@ -0,0 +1,130 @@
+/*********************************************************************
+
+    Collision kernel benchmark.
+
+    This program fills box sets of several sizes with random boxes on
+    the playfield and times collide_boxes() against the scalar
+    reference collide_boxes_scalar(). Before timing, both are run on
+    the same random sets and queries and their masks must agree; any
+    difference makes the program exit with a failure status.
+
+    Usage: bench_collision [passes]        (default 2000 passes)
+
+ ********************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include "collision.h"
+#include "frame_pacer.h"
+
+#define MAX_BOXES 16384
+#define LASER_COUNT 4
+
+// Returns a random float in [low, high).
+float random_range(float low, float high) {
+    return low + (high - low) * (rand() / (RAND_MAX + 1.0f));
+}
+
+// Fills the set with count random boxes and the query with random
+// shapes on a 400 x 600 playfield.
+void fill_random(BoxSet* set, int count, CollisionQuery* query) {
+    int i;
+
+    box_set_clear(set);
+    for(i = 0; i < count; i++) {
+        box_set_add(set, random_range(-200.0, 200.0), random_range(-300.0, 300.0),
+                    random_range(1.0, 40.0));
+    }
+    for(i = 0; i < LASER_COUNT; i++) {
+        query->laser_x[i] = random_range(-200.0, 200.0);
+    }
+    query->laser_count      = rand() % (LASER_COUNT + 1);
+    query->player_x         = random_range(-200.0, 200.0);
+    query->player_y         = random_range(-300.0, 300.0);
+    query->player_half_size = 12.5;
+    query->bottom_y         = -300.0 + random_range(0.0, 50.0);
+}
+
+// Runs both implementations on random inputs and returns the number
+// of boxes whose masks differ.
+int check_equivalence(BoxSet* set, CollisionQuery* query,
+                      CollisionMasks* expected, CollisionMasks* actual) {
+    int mismatches = 0;
+    int trial, i;
+
+    for(trial = 0; trial < 1000; trial++) {
+        fill_random(set, rand() % 100, query);
+        collide_boxes_scalar(set, query, expected);
+        collide_boxes(set, query, actual);
+        for(i = 0; i < set->count; i++) {
+            mismatches += expected->laser[i]  != actual->laser[i] ||
+                          expected->player[i] != actual->player[i] ||
+                          expected->bottom[i] != actual->bottom[i];
+        }
+    }
+    return mismatches;
+}
+
+// Returns the mean time in nanoseconds per box of one collision pass.
+double time_pass(void (*pass)(const BoxSet*, const CollisionQuery*, CollisionMasks*),
+                 BoxSet* set, CollisionQuery* query, CollisionMasks* masks,
+                 int passes) {
+    double start = pacer_now();
+    int i;
+
+    for(i = 0; i < passes; i++) {
+        pass(set, query, masks);
+    }
+    return (pacer_now() - start) * 1e9 / ((double)passes * set->count);
+}
+
+int main(int argc, char** argv) {
+    int sizes[] = { 1, 16, 256, 4096, MAX_BOXES };
+    int passes = 2000;
+    BoxSet* set = make_box_set(MAX_BOXES, MEM_ENTITIES);
+    CollisionMasks expected = make_collision_masks(MAX_BOXES, MEM_ENTITIES);
+    CollisionMasks actual   = make_collision_masks(MAX_BOXES, MEM_ENTITIES);
+    CollisionQuery query;
+    int mismatches, i;
+
+    if(argc > 1) {
+        passes = atoi(argv[1]);
+    }
+    query.laser_x = tracked_malloc(LASER_COUNT * sizeof(float), MEM_ENTITIES);
+    srand(445);
+
+#ifdef BLASTER_BUILD_INFO
+    printf("build: %s\n", BLASTER_BUILD_INFO);
+#endif
+#if defined(__AVX2__)
+    printf("kernel: AVX2 (8 boxes per iteration)\n");
+#elif defined(__SSE2__)
+    printf("kernel: SSE2 (4 boxes per iteration)\n");
+#else
+    printf("kernel: scalar\n");
+#endif
+
+    mismatches = check_equivalence(set, &query, &expected, &actual);
+    if(mismatches != 0) {
+        printf("FAIL: %d boxes differ from the scalar reference\n", mismatches);
+        return 1;
+    }
+    printf("equivalence: 1000 random sets match the scalar reference\n");
+
+    printf("%8s %14s %14s %8s\n", "boxes", "scalar ns/box", "kernel ns/box", "speedup");
+    for(i = 0; i < (int)(sizeof(sizes) / sizeof(sizes[0])); i++) {
+        double scalar_ns, kernel_ns;
+
+        fill_random(set, sizes[i], &query);
+        query.laser_count = LASER_COUNT;
+        scalar_ns = time_pass(collide_boxes_scalar, set, &query, &expected, passes);
+        kernel_ns = time_pass(collide_boxes, set, &query, &actual, passes);
+        printf("%8d %14.3f %14.3f %7.2fx\n", sizes[i], scalar_ns, kernel_ns,
+               scalar_ns / kernel_ns);
+    }
+
+    tracked_free(query.laser_x);
+    destroy_collision_masks(&expected);
+    destroy_collision_masks(&actual);
+    destroy_box_set(set);
+    return 0;
+}
@@ -0,0 +1,113 @@
+/*********************************************************************
+
+    Offscreen render benchmark for the blaster game.
+
+    This program draws a fixed scene (the player, a live enemy, a
+    mid-explosion enemy with its corners, and the laser) into an
+    offscreen framebuffer and times the frames with both lighting
+    paths: fixed-function lighting and the lit shader. The GLUT window
+    is only used to get a GL context and is hidden. The game logic is
+    built headless, so no timers fire while frames are being timed.
+
+    The camera maps the playfield onto the target, so any size works,
+    e.g. "bench_render 3840 2160" for a 4K target.
+
+    Usage: bench_render [width height [frames]]
+           (default 400 x 600, 500 frames)
+
+ ********************************************************************/
+#define BLASTER_HEADLESS
+#include "blaster.c"
+#include "offscreen.h"
+
+// Places every object on screen so that each frame draws the full
+// scene.
+void stage_scene() {
+    enemy->center.x = 50.0;
+    enemy->center.y = 100.0;
+    kill_enemy();
+
+    enemy->center.x = -50.0;
+    enemy->center.y = 0.0;
+    enemy->is_alive = 1;
+    is_laser_firing = 1;
+    corner_dist = 10;
+}
+
+// Draws frames into the bound target and returns the mean time per
+// frame in milliseconds. glFinish() is called so the time includes
+// the rasterization, not just the submission.
+double time_frames(int frames) {
+    double start;
+    int i;
+
+    for(i = 0; i < 10; i++) {
+        draw_all_objects();
+    }
+    glFinish();
+
+    start = pacer_now();
+    for(i = 0; i < frames; i++) {
+        draw_all_objects();
+    }
+    glFinish();
+    return (pacer_now() - start) * 1000.0 / frames;
+}
+
+int main(int argc, char** argv) {
+    int width = canvas_width;
+    int height = canvas_height;
+    int frames = 500;
+    OffscreenTarget* target;
+    LitShader* shader;
+    double fixed_ms, shader_ms;
+
+    glutInit(&argc, argv);
+    if(argc > 2) {
+        width  = atoi(argv[1]);
+        height = atoi(argv[2]);
+    }
+    if(argc > 3) {
+        frames = atoi(argv[3]);
+    }
+
+    target_frame_rate = 0;
+    init();
+    glutInitDisplayMode(GLUT_DOUBLE | GLUT_RGB);
+    glutInitWindowSize(64, 64);
+    glutCreateWindow("blaster render benchmark");
+    glutHideWindow();
+
+    target = make_offscreen_target(width, height, MEM_CONFIG);
+    if(target == NULL) {
+        fprintf(stderr, "cannot create a %d x %d offscreen target\n", width, height);
+        return 1;
+    }
+    bind_offscreen_target(target);
+    init_graphics();
+    stage_scene();
+
+    printf("renderer: %s\n", (const char*)glGetString(GL_RENDERER));
+    printf("target: %d x %d  frames: %d\n", width, height, frames);
+
+    shader = lit_shader;
+    lit_shader = NULL;
+    reshape(width, height);
+    fixed_ms = time_frames(frames);
+    printf("fixed-function: %8.3f ms/frame\n", fixed_ms);
+
+    if(shader == NULL) {
+        printf("lit shader:     unavailable\n");
+    }
+    else {
+        lit_shader = shader;
+        reshape(width, height);
+        shader_ms = time_frames(frames);
+        printf("lit shader:     %8.3f ms/frame (%.2fx)\n", shader_ms, fixed_ms / shader_ms);
+    }
+
+    bind_offscreen_target(NULL);
+    destroy_offscreen_target(target);
+    cleanup();
+    return 0;
+}
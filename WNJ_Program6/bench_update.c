@@ -0,0 +1,47 @@
+/*********************************************************************
+
+    Update loop benchmark for the blaster game.
+
+    This program runs the game headless on a simulated clock, with the
+    autopilot playing, and times the per-frame update (timers, input,
+    movement, collisions, and the explosion). No drawing is done.
+
+    Usage: bench_update [frames]        (default 10000000 frames)
+
+ ********************************************************************/
+#define BLASTER_HEADLESS
+#include "blaster.c"
+
+int main(int argc, char** argv) {
+    long frames = 10000000;
+    long i;
+    double start, elapsed;
+
+    if(argc > 1) {
+        frames = atol(argv[1]);
+    }
+
+    target_frame_rate = 30;
+    init();
+    spawn_enemy();
+
+    for(i = 0; i < frames / 100; i++) {
+        headless_tick();
+    }
+
+    start = pacer_now();
+    for(i = 0; i < frames && !is_game_over; i++) {
+        headless_tick();
+    }
+    elapsed = pacer_now() - start;
+
+#ifdef BLASTER_BUILD_INFO
+    printf("build: %s\n", BLASTER_BUILD_INFO);
+#endif
+    printf("frames: %ld  kills: %d  simulated time: %.1f s\n",
+           i, player_score, sim_time / 1000.0);
+    printf("update: %8.2f ns/frame\n", elapsed * 1e9 / i);
+
+    cleanup();
+    return is_game_over ? 1 : 0;
+}
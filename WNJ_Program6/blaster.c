@@ -11,18 +11,35 @@
 #include <stdio.h>
 #include <time.h>
 #include <math.h>
+#include <string.h>
+#define GL_GLEXT_PROTOTYPES
 #ifdef __APPLE__
 #  include <GLUT/glut.h>
 #else
 #  include <GL/glut.h>
 #endif
 #include "my_setup_3D.h"
-
-//  Constants for use with the my_setup() function.
+#include "mem_track.h"
+#include "collision.h"
+#include "frame_pacer.h"
+#include "vsync.h"
+#include "shader.h"
+#include "camera.h"
+#include "capture.h"
+#include "trace.h"
+
+//  Constants for use with the my_setup() function. The width and height
+//  are also the size of the logical playfield the game is laid out on.
 #define canvas_width 400
 #define canvas_height 600
 #define canvas_name "Blaster Game"
 
+//  The longest frame, in seconds, that the movement rates are scaled to.
+//  A longer stall (a window drag or a
+//  hitch) slows the game down for that frame instead of moving the
+//  enemy most of the way down the canvas at once.
+#define max_frame_interval (1.0 / 15.0)
+
 // Represents a point in 3-Dimensional space.
 typedef struct {
     float x;
@@ -70,6 +87,17 @@ float z_plane;
 // Float that represents the current frame rate of the animation
 float frame_rate;
 
+// Integer that represents the requested frame rate in frames per
+// second. A value of 0 leaves the frame rate uncapped.
+int target_frame_rate;
+
+// Pointer to the FramePacer object that times each frame.
+FramePacer* frame_pacer;
+
+// A boolean integer used to determine if the frame statistics overlay
+// is drawn.
+int is_overlay_visible;
+
 // Floats that represent the size of the player and enemy cubes
 float player_size;
 float enemy_size;
@@ -89,6 +117,31 @@ Color* player_color;
 Color* enemy_color;
 Color* corner_color;
 
+// Materials for the player (also used for the laser), the enemy ship
+// and its explosion, and the explosion corners.
+Material player_material;
+Material enemy_material;
+Material corner_material;
+
+// Pointer to the Camera object that maps the playfield onto the window.
+Camera* camera;
+
+// Pointer to the LitShader object used for lighting. NULL when the
+// fixed-function lighting path is in use.
+LitShader* lit_shader;
+
+// A boolean integer used to force the fixed-function lighting path.
+int use_fixed_function;
+
+// Pointer to the Capture object recording the game, and the path of
+// the file it records to. Both are NULL when not capturing.
+Capture* capture;
+char* capture_path;
+
+// The path of the file the trace is written to, or NULL when not
+// tracing.
+char* trace_file;
+
 // Pointers to Cube objects representing the player and enemy ships.
 Cube* player;
 Cube* enemy;
@@ -118,8 +171,21 @@ float player_step_dist;
 // firing.
 int is_laser_firing;
 
-// An integer representing the player's total score.
+// A boolean integer used to determine if a laser shot is waiting to
+// be tested against the enemy ships on the next collision pass.
+int is_shot_pending;
+
+// Box set holding the hitboxes of the live enemy ships, the masks
+// the collision pass writes its results into, and the query shapes
+// the boxes are tested against.
+BoxSet* enemy_boxes;
+CollisionMasks enemy_hits;
+CollisionQuery collision_query;
+
+// An integer representing the player's total score, and the buffer
+// the scoreboard formats it into.
 int player_score;
+char* score_text;
 
 // A boolean integer used to determine if the game has entered the
 // game over state.
@@ -164,6 +230,8 @@ int are_corners_visible;
 
 // Float values used to calculate movement rate for corners
 float corner_dist;
+float corner_speed;
+float corner_step_dist;
 
 
 
@@ -171,20 +239,77 @@ float corner_dist;
 // -------> Utility Functions <--------
 // ------------------------------------
 
-// Used as a constructor to initialize a new Point object.
-Point* make_point(float x, float y, float z) {
-    Point* point = (Point*)malloc(sizeof(Point));
+// Schedules func to be called with value after msecs milliseconds.
+// The headless build runs timers off its simulated clock instead of
+// GLUT's, so the game logic never has to call into GLUT.
+#ifdef BLASTER_HEADLESS
+#define MAX_TIMERS 16
+
+typedef struct {
+    double due;
+    void (*func)(int);
+    int value;
+} Timer;
+
+Timer timers[MAX_TIMERS];
+int timer_count;
+
+// Float that represents the simulated time in milliseconds.
+double sim_time;
+
+void schedule_timer(unsigned int msecs, void (*func)(int), int value) {
+    if(timer_count < MAX_TIMERS) {
+        timers[timer_count].due   = sim_time + msecs;
+        timers[timer_count].func  = func;
+        timers[timer_count].value = value;
+        timer_count++;
+    }
+}
 
+// Calls every timer whose due time has passed on the simulated clock.
+void run_due_timers() {
+    int i = 0;
+    while(i < timer_count) {
+        if(timers[i].due <= sim_time) {
+            Timer timer = timers[i];
+            timers[i] = timers[--timer_count];
+            timer.func(timer.value);
+        }
+        else {
+            i++;
+        }
+    }
+}
+#else
+void schedule_timer(unsigned int msecs, void (*func)(int), int value) {
+    glutTimerFunc(msecs, func, value);
+}
+#endif
+
+// Sets the coordinates of an existing Point object.
+void set_point(Point* point, float x, float y, float z) {
     point->x = x;
     point->y = y;
     point->z = z;
+}
+
+// Used as a constructor to initialize a new Point object.
+Point* make_point(float x, float y, float z, MemTag tag) {
+    Point* point = (Point*)tracked_malloc(sizeof(Point), tag);
+
+    set_point(point, x, y, z);
 
     return point;
 }
 
+// Frees a Point object created by make_point().
+void destroy_point(Point* point) {
+    tracked_free(point);
+}
+
 // Used as a constructor to initialize a new Color object.
-Color* make_color(float red, float green, float blue) {
-    Color* color = (Color*)malloc(sizeof(Color));
+Color* make_color(float red, float green, float blue, MemTag tag) {
+    Color* color = (Color*)tracked_malloc(sizeof(Color), tag);
 
     color->red   = red;
     color->green = green;
@@ -193,9 +318,14 @@ Color* make_color(float red, float green, float blue) {
     return color;
 }
 
-// Used as a constructor to initialize a new Color object.
-Cube* make_cube(Point* center, float size, Color* color) {
-    Cube* cube   = malloc(sizeof(Cube));
+// Frees a Color object created by make_color().
+void destroy_color(Color* color) {
+    tracked_free(color);
+}
+
+// Used as a constructor to initialize a new Cube object.
+Cube* make_cube(Point* center, float size, Color* color, MemTag tag) {
+    Cube* cube   = tracked_malloc(sizeof(Cube), tag);
     cube->center = *center;
     cube->size   = size;
     cube->color  = *color;
@@ -204,22 +334,50 @@ Cube* make_cube(Point* center, float size, Color* color) {
     return cube;
 }
 
-// Used as a constructor to initialize a new Quad object.
-Quad* make_quad(Point* v1, Point* v2, Point* v3, Point* v4, char axis) {
-    Quad* quad = malloc(sizeof(Quad));
+// Frees a Cube object created by make_cube().
+void destroy_cube(Cube* cube) {
+    tracked_free(cube);
+}
+
+// Sets the vertices of an existing Quad object and moves it back to
+// its untranslated, unrotated position.
+void set_quad(Quad* quad, Point* v1, Point* v2, Point* v3, Point* v4) {
     quad->vertices[0] = *v1;
     quad->vertices[1] = *v2;
     quad->vertices[2] = *v3;
     quad->vertices[3] = *v4;
-    quad->translation = *make_point(0.0, 0.0, 0.0);
+    set_point(&quad->translation, 0.0, 0.0, 0.0);
     quad->rotation_angle = 0;
+}
+
+// Used as a constructor to initialize a new Quad object.
+Quad* make_quad(Point* v1, Point* v2, Point* v3, Point* v4, MemTag tag) {
+    Quad* quad = tracked_malloc(sizeof(Quad), tag);
+    set_quad(quad, v1, v2, v3, v4);
+    quad->center = *v1;
     return quad;
 }
 
+// Frees a Quad object created by make_quad().
+void destroy_quad(Quad* quad) {
+    tracked_free(quad);
+}
+
+// Calculates how far the player, the enemy, and the explosion move
+// each frame from the current frame rate.
+void update_step_rates() {
+    enemy_step_dist  = (enemy_total_dist / enemy_total_time) * frame_rate;
+    player_step_dist = (player_total_dist / player_total_time) * frame_rate;
+    side_explosion_move_step   = (side_explosion_dist / side_explosion_time) * frame_rate;
+    side_explosion_rotate_step = (side_explosion_total_rotation / side_explosion_time) * frame_rate;
+    corner_step_dist = corner_speed * frame_rate;
+}
+
 // Sets the enemy's center point to a random point along the top of 
 // the canvas, and then calls itself again after a time interval 
 // between 2.75 and 3.50 minutes. 
 void spawn_enemy() {
+    TRACE_BEGIN("spawn_enemy");
     srand(time(NULL) * -time(NULL));
     enemy_spawn_x = (rand() % ((enemy_max_x+1) - enemy_min_x)) + enemy_min_x;
     enemy->center.y = enemy_start->y;
@@ -228,19 +386,15 @@ void spawn_enemy() {
     srand(time(NULL));
     enemy_spawn_time = (rand() % (enemy_max_time+1 - enemy_min_time)) + enemy_min_time;
     enemy->is_alive = 1;
-    glutTimerFunc(enemy_spawn_time, spawn_enemy, 1);
+    schedule_timer(enemy_spawn_time, spawn_enemy, 1);
+    TRACE_END("spawn_enemy");
 }
 
 // Updates the enemy's center point, allowing it to move down the 
-// canvas. Also checks if the enemy has reached the bottom of the
-// canvas and triggers a game over if so. The method also updates
-// the vertices of the side panel
+// canvas.
 void update_enemy() {
     if(enemy->is_alive) {
         enemy->center.y -= enemy_step_dist;
-        if((enemy->center.y - (enemy->size / 2)) < (origin->y - (canvas_height / 2))) {
-            is_game_over = 1;
-        }
     }
 }
 
@@ -262,120 +416,151 @@ void add_point() {
 
 // Ends the explosion animation
 void disable_explosion() {
+    TRACE_BEGIN("disable_explosion");
     is_exploding = 0;
+    TRACE_END("disable_explosion");
 }
 
 // Initiates the explosion animation 
 void activate_explosion() {
     is_exploding = 1;
-    glutTimerFunc(1000 * side_explosion_time, disable_explosion, 1);
+    schedule_timer(1000 * side_explosion_time, disable_explosion, 1);
 }
 
 // Kills the enemy ship, keeping it from being drawn until
-// another is drawn. The sides of the cube are then initialized,
-// and the explosion animation flag is triggered.
+// another is drawn. The sides and corners of the cube are moved to
+// the enemy's position, and the explosion animation flag is
+// triggered. The explosion objects are created once in init(), so
+// no memory is allocated here.
 void kill_enemy() {
-    Point* left_top_f = make_point(enemy->center.x - (enemy->size / 2), 
-                                   enemy->center.y + (enemy->size / 2), 
-                                   enemy->center.z - (enemy->size / 2));
-
-    Point* right_top_f = make_point(enemy->center.x + (enemy->size / 2), 
-                                   enemy->center.y + (enemy->size / 2), 
-                                   enemy->center.z - (enemy->size / 2));
-
-    Point* right_bot_f = make_point(enemy->center.x + (enemy->size / 2), 
-                                   enemy->center.y - (enemy->size / 2), 
-                                   enemy->center.z - (enemy->size / 2));
-
-    Point* left_bot_f = make_point(enemy->center.x - (enemy->size / 2), 
-                                   enemy->center.y - (enemy->size / 2), 
-                                   enemy->center.z - (enemy->size / 2));
-
-    Point* right_top_b = make_point(enemy->center.x + (enemy->size / 2), 
-                                   enemy->center.y + (enemy->size / 2), 
-                                   enemy->center.z + (enemy->size / 2));
-
-    Point* left_top_b = make_point(enemy->center.x - (enemy->size / 2), 
-                                   enemy->center.y + (enemy->size / 2), 
-                                   enemy->center.z + (enemy->size / 2));
-
-    Point* left_bot_b = make_point(enemy->center.x - (enemy->size / 2), 
-                                   enemy->center.y - (enemy->size / 2), 
-                                   enemy->center.z + (enemy->size / 2));
-
-    Point* right_bot_b = make_point(enemy->center.x + (enemy->size / 2), 
-                                   enemy->center.y - (enemy->size / 2), 
-                                   enemy->center.z + (enemy->size / 2));
-
-    top_side    = make_quad(right_top_b, left_top_b, left_top_f, right_top_f, 'x');
-    top_side->center = *make_point(enemy->center.x, 
-                                  enemy->center.y + (enemy->size / 2), 
-                                  enemy->center.z);
+    TRACE_BEGIN("kill_enemy");
+    Point left_top_f = { enemy->center.x - (enemy->size / 2),
+                         enemy->center.y + (enemy->size / 2),
+                         enemy->center.z - (enemy->size / 2) };
+
+    Point right_top_f = { enemy->center.x + (enemy->size / 2),
+                          enemy->center.y + (enemy->size / 2),
+                          enemy->center.z - (enemy->size / 2) };
+
+    Point right_bot_f = { enemy->center.x + (enemy->size / 2),
+                          enemy->center.y - (enemy->size / 2),
+                          enemy->center.z - (enemy->size / 2) };
+
+    Point left_bot_f = { enemy->center.x - (enemy->size / 2),
+                         enemy->center.y - (enemy->size / 2),
+                         enemy->center.z - (enemy->size / 2) };
+
+    Point right_top_b = { enemy->center.x + (enemy->size / 2),
+                          enemy->center.y + (enemy->size / 2),
+                          enemy->center.z + (enemy->size / 2) };
+
+    Point left_top_b = { enemy->center.x - (enemy->size / 2),
+                         enemy->center.y + (enemy->size / 2),
+                         enemy->center.z + (enemy->size / 2) };
+
+    Point left_bot_b = { enemy->center.x - (enemy->size / 2),
+                         enemy->center.y - (enemy->size / 2),
+                         enemy->center.z + (enemy->size / 2) };
+
+    Point right_bot_b = { enemy->center.x + (enemy->size / 2),
+                          enemy->center.y - (enemy->size / 2),
+                          enemy->center.z + (enemy->size / 2) };
+
+    set_quad(top_side, &right_top_b, &left_top_b, &left_top_f, &right_top_f);
+    set_point(&top_side->center, enemy->center.x,
+                                 enemy->center.y + (enemy->size / 2),
+                                 enemy->center.z);
+
+    set_quad(right_side, &right_top_b, &right_top_f, &right_bot_f, &right_bot_b);
+    set_point(&right_side->center, enemy->center.x + (enemy->size / 2),
+                                   enemy->center.y,
+                                   enemy->center.z);
 
-    right_side  = make_quad(right_top_b, right_top_f, right_bot_f, right_bot_b, 'y');
-    right_side->center = *make_point(enemy->center.x + (enemy->size / 2), 
-                                    enemy->center.y, 
+    set_quad(bottom_side, &right_bot_f, &left_bot_f, &left_bot_b, &right_bot_b);
+    set_point(&bottom_side->center, enemy->center.x,
+                                    enemy->center.y - (enemy->size / 2),
                                     enemy->center.z);
 
-    bottom_side = make_quad(right_bot_f, left_bot_f, left_bot_b, right_bot_b, 'x');
-    bottom_side->center = *make_point(enemy->center.x, 
-                                     enemy->center.y - (enemy->size / 2), 
-                                     enemy->center.z);
-
-    left_side   = make_quad(left_top_f, left_top_b, left_bot_b, left_bot_f, 'y');
-    left_side->center = *make_point(enemy->center.x - (enemy->size / 2),
-                                   enemy->center.y, 
-                                   enemy->center.z);
-
-    front_side  = make_quad(right_top_f, left_top_f, left_bot_f, right_bot_f, 'y');
-    front_side->center = *make_point(enemy->center.x, 
-                                    enemy->center.y, 
-                                    enemy->center.z - (enemy->size / 2));
+    set_quad(left_side, &left_top_f, &left_top_b, &left_bot_b, &left_bot_f);
+    set_point(&left_side->center, enemy->center.x - (enemy->size / 2),
+                                  enemy->center.y,
+                                  enemy->center.z);
 
-    back_side   = make_quad(left_top_b, right_top_b, right_bot_b, left_bot_b, 'y');
-    back_side->center = *make_point(enemy->center.x, 
-                                   enemy->center.y, 
-                                   enemy->center.z + (enemy->size / 2));
+    set_quad(front_side, &right_top_f, &left_top_f, &left_bot_f, &right_bot_f);
+    set_point(&front_side->center, enemy->center.x,
+                                   enemy->center.y,
+                                   enemy->center.z - (enemy->size / 2));
 
-    left_top_f_corner = make_cube(left_top_f, 3, corner_color);
-    right_top_f_corner = make_cube(right_top_f, 3, corner_color);
-    right_bot_f_corner = make_cube(right_bot_f, 3, corner_color);
-    left_bot_f_corner = make_cube(left_bot_f, 3, corner_color);
-    right_top_b_corner = make_cube(right_top_b, 3, corner_color);
-    left_top_b_corner = make_cube(left_top_b, 3, corner_color);
-    left_bot_b_corner = make_cube(left_bot_b, 3, corner_color);
-    right_bot_b_corner = make_cube(right_bot_b, 3, corner_color);
+    set_quad(back_side, &left_top_b, &right_top_b, &right_bot_b, &left_bot_b);
+    set_point(&back_side->center, enemy->center.x,
+                                  enemy->center.y,
+                                  enemy->center.z + (enemy->size / 2));
 
+    left_top_f_corner->center = left_top_f;
+    right_top_f_corner->center = right_top_f;
+    right_bot_f_corner->center = right_bot_f;
+    left_bot_f_corner->center = left_bot_f;
+    right_top_b_corner->center = right_top_b;
+    left_top_b_corner->center = left_top_b;
+    left_bot_b_corner->center = left_bot_b;
+    right_bot_b_corner->center = right_bot_b;
 
     activate_explosion();
     are_corners_visible = 1;
     enemy->is_alive = 0;
+    TRACE_END("kill_enemy");
 }
 
-// Checks to see if the laser has been fired within the hitbox of the
-// enemy ship. Kills the enemy and adds a point to the player's score
-// if the hit is successful.
-void test_hit() {
-    if(player->center.x < enemy->center.x + (enemy->size / 2) &&
-       player->center.x > enemy->center.x - (enemy->size / 2)) {
-        kill_enemy();
-        add_point();
+// Runs the collision pass for the current frame. The live enemy
+// ships are tested against a pending laser shot, the player's ship,
+// and the bottom of the canvas. A laser hit kills the enemy and adds
+// a point to the player's score; touching the player or reaching the
+// bottom of the canvas triggers a game over.
+void check_collisions() {
+    int i;
+
+    TRACE_BEGIN("check_collisions");
+    box_set_clear(enemy_boxes);
+    if(enemy->is_alive) {
+        box_set_add(enemy_boxes, enemy->center.x, enemy->center.y, enemy->size);
     }
+
+    collision_query.laser_x[0]       = player->center.x;
+    collision_query.laser_count      = is_shot_pending;
+    collision_query.player_x         = player->center.x;
+    collision_query.player_y         = player->center.y;
+    collision_query.player_half_size = player->size / 2;
+    collision_query.bottom_y         = origin->y - (canvas_height / 2);
+    is_shot_pending = 0;
+
+    collide_boxes(enemy_boxes, &collision_query, &enemy_hits);
+
+    for(i = 0; i < enemy_boxes->count; i++) {
+        if(enemy_hits.laser[i]) {
+            kill_enemy();
+            add_point();
+        }
+        else if(enemy_hits.player[i] || enemy_hits.bottom[i]) {
+            is_game_over = 1;
+        }
+    }
+    TRACE_END("check_collisions");
 }
 
 // Disables the laser from being drawn.
 void disable_laser() {
+    TRACE_BEGIN("disable_laser");
     is_laser_firing = 0;
+    TRACE_END("disable_laser");
 }
 
-// Activates the drawing of the laser, initiates a check to see if the
-// enemy ship has been hit, and disables drawing of the laser after
-// 0.15 seconds.
+// Activates the drawing of the laser, queues the shot for the next
+// collision pass, and disables drawing of the laser after 0.15 seconds.
 void activate_laser() {
     if(is_laser_firing == 0) {
         is_laser_firing = 1;
-        test_hit();
-        glutTimerFunc(1000 * (0.15), disable_laser, 1);
+        is_shot_pending = 1;
+        schedule_timer(1000 * (0.15), disable_laser, 1);
     }
 }
 
@@ -405,11 +590,57 @@ void check_distance() {
 // 
 void update_corners() {
     if(are_corners_visible) {
-        corner_dist += 2;
+        corner_dist += corner_step_dist;
         check_distance();
     }
 }
 
+// Frees every object created by init().
+void cleanup() {
+    destroy_quad(top_side);
+    destroy_quad(right_side);
+    destroy_quad(bottom_side);
+    destroy_quad(left_side);
+    destroy_quad(front_side);
+    destroy_quad(back_side);
+
+    destroy_cube(left_top_f_corner);
+    destroy_cube(right_top_f_corner);
+    destroy_cube(right_bot_f_corner);
+    destroy_cube(left_bot_f_corner);
+    destroy_cube(right_top_b_corner);
+    destroy_cube(left_top_b_corner);
+    destroy_cube(left_bot_b_corner);
+    destroy_cube(right_bot_b_corner);
+
+    tracked_free(collision_query.laser_x);
+    destroy_collision_masks(&enemy_hits);
+    destroy_box_set(enemy_boxes);
+    tracked_free(score_text);
+
+    destroy_cube(player);
+    destroy_cube(enemy);
+    destroy_point(player_start);
+    destroy_point(enemy_start);
+
+    destroy_color(bg_color);
+    destroy_color(player_color);
+    destroy_color(enemy_color);
+    destroy_color(corner_color);
+
+    if(capture != NULL) {
+        destroy_capture(capture);
+        capture = NULL;
+    }
+    if(lit_shader != NULL) {
+        destroy_lit_shader(lit_shader);
+        lit_shader = NULL;
+    }
+    destroy_camera(camera);
+    destroy_frame_pacer(frame_pacer);
+    destroy_point(origin);
+}
+
 
 // ------------------------------------
 // -------> Drawing Functions <--------
@@ -469,10 +700,10 @@ void draw_quad(Quad* quad, char axis) {
 
     
     glBegin(GL_QUADS);
-        glVertex3fv(&quad->vertices[0]);
-        glVertex3fv(&quad->vertices[1]);
-        glVertex3fv(&quad->vertices[2]);
-        glVertex3fv(&quad->vertices[3]);
+        glVertex3fv(&quad->vertices[0].x);
+        glVertex3fv(&quad->vertices[1].x);
+        glVertex3fv(&quad->vertices[2].x);
+        glVertex3fv(&quad->vertices[3].x);
     glEnd();
 
     glPopMatrix();
@@ -481,7 +712,7 @@ void draw_quad(Quad* quad, char axis) {
 // Draws the corners during the explosion animation
 void draw_corners() {
     glPushMatrix();
-    glLoadIdentity();
+    glLoadMatrixf(camera->view);
     glTranslatef(left_top_f_corner->center.x - corner_dist,
                  left_top_f_corner->center.y + corner_dist,
                  left_top_f_corner->center.z - corner_dist);
@@ -489,7 +720,7 @@ void draw_corners() {
     glPopMatrix();
 
     glPushMatrix();
-    glLoadIdentity();
+    glLoadMatrixf(camera->view);
     glTranslatef(right_top_f_corner->center.x + corner_dist,
                  right_top_f_corner->center.y + corner_dist,
                  right_top_f_corner->center.z - corner_dist);
@@ -497,7 +728,7 @@ void draw_corners() {
     glPopMatrix();
 
     glPushMatrix();
-    glLoadIdentity();
+    glLoadMatrixf(camera->view);
     glTranslatef(right_bot_f_corner->center.x + corner_dist,
                  right_bot_f_corner->center.y - corner_dist,
                  right_bot_f_corner->center.z - corner_dist);
@@ -505,7 +736,7 @@ void draw_corners() {
     glPopMatrix();
 
     glPushMatrix();
-    glLoadIdentity();
+    glLoadMatrixf(camera->view);
     glTranslatef(left_bot_f_corner->center.x - corner_dist,
                  left_bot_f_corner->center.y - corner_dist,
                  left_bot_f_corner->center.z - corner_dist);
@@ -513,7 +744,7 @@ void draw_corners() {
     glPopMatrix();
 
     glPushMatrix();
-    glLoadIdentity();
+    glLoadMatrixf(camera->view);
     glTranslatef(left_top_b_corner->center.x - corner_dist,
                  left_top_b_corner->center.y + corner_dist,
                  left_top_b_corner->center.z + corner_dist);
@@ -521,7 +752,7 @@ void draw_corners() {
     glPopMatrix();
 
     glPushMatrix();
-    glLoadIdentity();
+    glLoadMatrixf(camera->view);
     glTranslatef(right_top_b_corner->center.x + corner_dist,
                  right_top_b_corner->center.y + corner_dist,
                  right_top_b_corner->center.z + corner_dist);
@@ -529,7 +760,7 @@ void draw_corners() {
     glPopMatrix();
 
     glPushMatrix();
-    glLoadIdentity();
+    glLoadMatrixf(camera->view);
     glTranslatef(right_bot_b_corner->center.x + corner_dist,
                  right_bot_b_corner->center.y - corner_dist,
                  right_bot_b_corner->center.z + corner_dist);
@@ -537,7 +768,7 @@ void draw_corners() {
     glPopMatrix();
 
     glPushMatrix();
-    glLoadIdentity();
+    glLoadMatrixf(camera->view);
     glTranslatef(left_bot_b_corner->center.x - corner_dist,
                  left_bot_b_corner->center.y - corner_dist,
                  left_bot_b_corner->center.z + corner_dist);
@@ -545,9 +776,19 @@ void draw_corners() {
     glPopMatrix();
 }
 
+// Sets the color of the text drawn next. Lighting is turned off first,
+// since a raster position is otherwise lit like a vertex, and the text
+// would take its color from whatever lighting state the last frame
+// left behind.
+void set_text_color(Color* color) {
+    glDisable(GL_LIGHTING);
+    glColor3f(color->red, color->green, color->blue);
+}
+
 // Draws the scoreboard onto the top right of the canvas.
 void draw_scoreboard() {
-    glRasterPos3f(125.0, 280.0, z_plane + 15);
+    set_text_color(player_color);
+    glRasterPos3f((canvas_width / 2) - 75.0, (canvas_height / 2) - 20.0, z_plane + 15);
     char *string = "Score: ";
     char *c;
     for (c = string; *c != '\0'; c++)
@@ -555,9 +796,8 @@ void draw_scoreboard() {
         glutBitmapCharacter(GLUT_BITMAP_8_BY_13, *c);
     }
 
-    char* score[20];
-    sprintf(score, "%d", player_score);
-    for (c = score; *c != '\0'; c++)
+    sprintf(score_text, "%d", player_score);
+    for (c = score_text; *c != '\0'; c++)
     {
         glutBitmapCharacter(GLUT_BITMAP_8_BY_13, *c);
     }
@@ -585,31 +825,75 @@ void light_init() {
     glLightModeli(GL_LIGHT_MODEL_LOCAL_VIEWER, GL_TRUE);
 }
 
-// Draws all of the objects onto the canvas. Materials are also set here.
+// Draws the frame and memory statistics overlay onto the top left of
+// the canvas.
+void draw_overlay() {
+    char stats[64];
+    char *c;
+    double mean = frame_pacer_mean(frame_pacer);
+
+    sprintf(stats, "%.1f fps  jitter %.2f ms  Q%d",
+            mean > 0.0 ? 1.0 / mean : 0.0,
+            frame_pacer_jitter(frame_pacer) * 1000.0,
+            frame_pacer->quality);
+    set_text_color(player_color);
+    glRasterPos3f(-(canvas_width / 2) + 10.0, (canvas_height / 2) - 20.0, z_plane + 15);
+    for (c = stats; *c != '\0'; c++)
+    {
+        glutBitmapCharacter(GLUT_BITMAP_8_BY_13, *c);
+    }
+
+    sprintf(stats, "mem %zu B  peak %zu B",
+            mem_total_live_bytes, mem_total_peak_bytes);
+    glRasterPos3f(-(canvas_width / 2) + 10.0, (canvas_height / 2) - 35.0, z_plane + 15);
+    for (c = stats; *c != '\0'; c++)
+    {
+        glutBitmapCharacter(GLUT_BITMAP_8_BY_13, *c);
+    }
+}
+
+// Sets the material used for the objects drawn next, either as shader
+// uniforms or as fixed-function material state.
 // CITATION:
 // This method of setting materials comes from the textbook on pages 
 // 426-427.
+void apply_material(Material* material) {
+    if(lit_shader != NULL) {
+        lit_shader_set_material(lit_shader, material);
+    }
+    else {
+        glMaterialfv(GL_FRONT_AND_BACK, GL_AMBIENT, material->ambient);
+        glMaterialfv(GL_FRONT_AND_BACK, GL_DIFFUSE, material->diffuse);
+        glMaterialfv(GL_FRONT_AND_BACK, GL_SPECULAR, material->specular);
+        glMaterialfv(GL_FRONT_AND_BACK, GL_SHININESS, &material->shininess);
+    }
+}
+
+// Draws all of the objects onto the canvas. The text is drawn first,
+// unlit and without the shader, since raster positions are transformed
+// by the program in use; the objects are then lit either by the lit shader
+// or by fixed-function lighting. The caller swaps the buffers, so the
+// same function can draw into an offscreen target.
 void draw_all_objects() {
-    float player_diffuse[] = { 0.0, 0.0, 0.0, 1.0 };
-    float enemy_ambient[] = { 1.0, 0.0, 0.0, 1.0 };
-    float enemy_diffuse[] = { 0.8, 0.0, 0.0, 1.0 };
-    float corners_diffuse[] = { 0.0, 0.9, 0.0, 1.0 };
-    float specular[] = { 1.0, 1.0, 1.0, 1.0 };
-    float shine[] = { 50.0 };
     glClearColor(bg_color->red, bg_color->green, bg_color->blue, 0.0);
     glClear(GL_COLOR_BUFFER_BIT);
     draw_scoreboard();
-    light_init();
-    glMaterialfv(GL_FRONT_AND_BACK, GL_AMBIENT_AND_DIFFUSE, player_diffuse);
-    glMaterialfv(GL_FRONT_AND_BACK, GL_SPECULAR, specular);
-    glMaterialfv(GL_FRONT_AND_BACK, GL_SHININESS, shine);
+    if(is_overlay_visible) {
+        draw_overlay();
+    }
+    if(lit_shader != NULL) {
+        glUseProgram(lit_shader->program);
+    }
+    else {
+        light_init();
+    }
+    apply_material(&player_material);
     draw_cube(player);
-    glMaterialfv(GL_FRONT_AND_BACK, GL_AMBIENT, enemy_ambient);
-    glMaterialfv(GL_FRONT_AND_BACK, GL_DIFFUSE, enemy_diffuse);
+    apply_material(&enemy_material);
     if(enemy->is_alive) {
         draw_cube(enemy);
     }
-    if(is_exploding) {
+    if(is_exploding && frame_pacer->quality >= 1) {
         draw_quad(front_side, 'y');
         draw_quad(right_side, 'y');
         draw_quad(back_side, 'y');
@@ -617,16 +901,18 @@ void draw_all_objects() {
         draw_quad(top_side, 'x');
         draw_quad(bottom_side, 'x');
     }
-    if(are_corners_visible) {
-        glMaterialfv(GL_FRONT_AND_BACK, GL_AMBIENT_AND_DIFFUSE, corners_diffuse);
+    if(are_corners_visible && frame_pacer->quality >= 2) {
+        apply_material(&corner_material);
         draw_corners();
     }
-    glMaterialfv(GL_FRONT_AND_BACK, GL_AMBIENT_AND_DIFFUSE, player_diffuse);
+    apply_material(&player_material);
     if(is_laser_firing) {
         
         draw_laser(player);
     }
-    glutSwapBuffers();
+    if(lit_shader != NULL) {
+        glUseProgram(0);
+    }
 }
 
 // Draws a game over message when the player has failed to kill the 
@@ -634,6 +920,7 @@ void draw_all_objects() {
 void draw_game_over() {
     glClearColor(1.0, 1.0, 1.0, 0.0);
     glClear(GL_COLOR_BUFFER_BIT);
+    set_text_color(player_color);
     glRasterPos3f(-80.0, 0.0, z_plane + 15);
     char *string = "Too Bad! You Lost...";
     char *c;
@@ -645,42 +932,160 @@ void draw_game_over() {
 }
 
 
+// Advances the game by one frame: the centers of both the enemy and
+// player are updated, collisions are checked, and the explosion is
+// moved along.
+void update_game() {
+    TRACE_BEGIN("update_game");
+    update_enemy();
+    update_player();
+    check_collisions();
+    update_sides();
+    update_corners();
+    TRACE_END("update_game");
+}
+
 // If the game is not currently in a game over state, then all the 
-// objects will be drawn, centers of both the enemy and player will
-// be updated, and then the function will be called again after a
-// time interval equal to the current frame rate has passed.
+// objects will be drawn (and captured, if recording) and the game will
+// be updated. The frame pacer
+// then waits out the rest of the frame before the function is called
+// again. The movement rates are recalculated from the measured length
+// of the last frame, clamped to max_frame_interval, so a frame that
+// overruns its deadline does not slow the game down.
 void animate() {
+    TRACE_BEGIN("animate");
     if(!is_game_over) {
+        TRACE_BEGIN("draw_all_objects");
         draw_all_objects();
-        update_enemy();
-        update_player();
-        update_sides();
-        update_corners();
-        glutTimerFunc(1000 * frame_rate, animate, 1);
+        TRACE_END("draw_all_objects");
+        if(capture != NULL) {
+            capture_frame(capture, camera->viewport_x, camera->viewport_y,
+                          camera->viewport_width, camera->viewport_height);
+        }
+        TRACE_BEGIN("swap");
+        glutSwapBuffers();
+        TRACE_END("swap");
+        frame_pacer_mark_swap(frame_pacer);
+        if(capture != NULL) {
+            capture_poll(capture);
+        }
+        if(frame_pacer->last_interval > 0.0) {
+            frame_rate = frame_pacer->last_interval < max_frame_interval ?
+                         frame_pacer->last_interval : max_frame_interval;
+            update_step_rates();
+        }
+        update_game();
+        if(capture != NULL) {
+            capture_poll(capture);
+        }
+        TRACE_BEGIN("frame_pacer_wait");
+        frame_pacer_wait(frame_pacer);
+        TRACE_END("frame_pacer_wait");
+        glutTimerFunc(0, animate, 1);
     }
     else {
         draw_game_over();
     }
+    TRACE_END("animate");
 }
 
-// 
-void initial_draw() {
+// Matches the frame rate to the display. An uncapped game turns off the
+// wait for the vertical refresh. A capped game turns it on and measures
+// the refresh period; a requested rate faster than the display can show
+// is lowered to the display's rate, since otherwise every frame would
+// overrun and the frame pacer would drop the quality level for good.
+void sync_to_display() {
+    double refresh_period;
+    int refresh_rate;
+
+    if(target_frame_rate == 0) {
+        if(!set_swap_interval(0)) {
+            fprintf(stderr, "cannot turn off vsync; uncapped frames wait for the display\n");
+        }
+        return;
+    }
+    set_swap_interval(1);
+    refresh_period = measure_refresh_period(draw_all_objects);
+    if(refresh_period > 0.0 && 1.0 / target_frame_rate < refresh_period * 0.95) {
+        refresh_rate = (int)(1.0 / refresh_period + 0.5);
+        fprintf(stderr, "%d fps is faster than the display (%d Hz); running at %d fps\n",
+                target_frame_rate, refresh_rate, refresh_rate);
+        target_frame_rate = refresh_rate;
+        frame_rate = 1.0 / target_frame_rate;
+        update_step_rates();
+    }
+    frame_pacer_set_rate(frame_pacer, target_frame_rate);
+}
+
+// Starts the game once the window is on screen: the frame rate is
+// matched to the display, the capture (if requested) is started at
+// that rate, the first enemy is spawned, and the animation loop is
+// started. Must only be called once. The capture records the playfield
+// at its logical size, whatever size the window is resized to. An
+// uncapped game is recorded at 30 frames per second; the capture
+// repeats or skips frames to keep to that rate.
+void start_game() {
+    sync_to_display();
+    if(capture_path != NULL) {
+        capture = make_capture(capture_path, canvas_width, canvas_height,
+                               target_frame_rate > 0 ? target_frame_rate : 30, MEM_CAPTURE);
+    }
     spawn_enemy();
     glutTimerFunc(1000 * frame_rate, animate, 1);
 }
 
+// Display callback. The first call, once the window is on screen,
+// starts the game. Later calls, such as the redisplay freeglut posts
+// after every reshape or expose, only redraw the current frame, so
+// resizing the window neither moves the enemy nor starts another
+// spawn or animation timer.
+void display() {
+    static int is_started = 0;
+
+    if(!is_started) {
+        is_started = 1;
+        start_game();
+    }
+    if(is_game_over) {
+        draw_game_over();
+    }
+    else {
+        draw_all_objects();
+        glutSwapBuffers();
+    }
+}
+
 
 
 // ------------------------------------
 // -----> User Input Functions <-------
 // ------------------------------------
 
+// Quits the game, printing the frame, capture, and memory statistics
+// and writing the trace. Must not be called from inside a traced scope,
+// or the trace would end with a begin event that is never closed.
+void quit_game() {
+    frame_pacer_report(frame_pacer, stdout);
+    if(capture != NULL) {
+        capture_finish(capture);
+        capture_report(capture, stdout);
+    }
+    trace_stop();
+    cleanup();
+    mem_report(stdout);
+    exit(0);
+}
+
 // Allows the game to be controlled using the keyboard. 
 //      - The 'H' key moves the player left.
 //      - The 'L' key moves the player right.
 //      - The spacebar fires the laser.
-//      - The 'Q' key quits the game.
+//      - The 'F' key toggles the frame statistics overlay.
+//      - The 'Q' key quits the game once the key has been handled.
 void handle_keys(unsigned char c, GLint x, GLint y) {
+    int is_quitting = 0;
+
+    TRACE_BEGIN("handle_keys");
     if(c == 'h' || c == 'h') {
         player->movement = 1;
     }
@@ -690,9 +1095,16 @@ void handle_keys(unsigned char c, GLint x, GLint y) {
     else if(c == ' ') {
         activate_laser();
     }
+    else if(c == 'f' || c == 'F') {
+        is_overlay_visible = !is_overlay_visible;
+    }
     else if ((c == 'q') || (c == 'Q'))
     {
-        exit(0);
+        is_quitting = 1;
+    }
+    TRACE_END("handle_keys");
+    if(is_quitting) {
+        quit_game();
     }
 }
 
@@ -713,29 +1125,81 @@ void handle_keys_up(unsigned char c, GLint x, GLint y) {
 // --------> Main Functions <----------
 // ------------------------------------
 
+// Reads the options from the command line. The frame rate may be given
+// as a number of frames per second (e.g. 30, 60, 120) or as "uncapped",
+// and defaults to 30 frames per second. "fixed" selects fixed-function
+// lighting instead of the lit shader. "capture" followed by a file name
+// records the game to that file, and "trace" followed by a file name
+// writes a Chrome trace of the game loop to that file.
+void parse_args(int argc, char** argv) {
+    int i;
+
+    target_frame_rate  = 30;
+    use_fixed_function = 0;
+    capture_path       = NULL;
+    trace_file         = NULL;
+    for(i = 1; i < argc; i++) {
+        if(strcmp(argv[i], "uncapped") == 0) {
+            target_frame_rate = 0;
+        }
+        else if(strcmp(argv[i], "capture") == 0 && i + 1 < argc) {
+            capture_path = argv[++i];
+        }
+        else if(strcmp(argv[i], "trace") == 0 && i + 1 < argc) {
+            trace_file = argv[++i];
+        }
+        else if(strcmp(argv[i], "fixed") == 0) {
+            use_fixed_function = 1;
+        }
+        else if(atoi(argv[i]) > 0) {
+            target_frame_rate = atoi(argv[i]);
+        }
+        else {
+            fprintf(stderr, "usage: %s [fps | uncapped] [fixed] [capture file] "
+                            "[trace file]\n", argv[0]);
+            exit(1);
+        }
+    }
+}
+
 // Initializes the objects and variables that will be used.
 void init() {
-    origin = make_point(0.0, 0.0, 0.0);
+    origin = make_point(0.0, 0.0, 0.0, MEM_CONFIG);
     z_plane = -25.0;
-    frame_rate = 1.0 / 30.0;
+
+    // An uncapped game starts at 30 frames per second until the first
+    // frame has been measured.
+    frame_rate = 1.0 / (target_frame_rate > 0 ? target_frame_rate : 30);
+    frame_pacer = make_frame_pacer(target_frame_rate, MEM_CONFIG);
+    camera = make_camera(canvas_width, canvas_height, MEM_CONFIG);
+    is_overlay_visible = 0;
 
     player_size = 25.0;
     enemy_size  = 25.0;
 
-    bg_color     = make_color(1.0, 1.0, 1.0);
-    player_color = make_color(0.0, 0.0, 0.0);
-    enemy_color  = make_color(0.9, 0.1, 0.1);
-    corner_color = make_color(0.0, 0.9, 0.0);
+    bg_color     = make_color(1.0, 1.0, 1.0, MEM_CONFIG);
+    player_color = make_color(0.0, 0.0, 0.0, MEM_CONFIG);
+    enemy_color  = make_color(0.9, 0.1, 0.1, MEM_CONFIG);
+    corner_color = make_color(0.0, 0.9, 0.0, MEM_CONFIG);
+
+    player_material = (Material){ { 0.0, 0.0, 0.0, 1.0 }, { 0.0, 0.0, 0.0, 1.0 },
+                                  { 1.0, 1.0, 1.0, 1.0 }, 50.0 };
+    enemy_material  = (Material){ { 1.0, 0.0, 0.0, 1.0 }, { 0.8, 0.0, 0.0, 1.0 },
+                                  { 1.0, 1.0, 1.0, 1.0 }, 50.0 };
+    corner_material = (Material){ { 0.0, 0.9, 0.0, 1.0 }, { 0.0, 0.9, 0.0, 1.0 },
+                                  { 1.0, 1.0, 1.0, 1.0 }, 50.0 };
+    lit_shader = NULL;
+    capture = NULL;
 
     player_start = make_point(origin->x,
                               origin->y - (canvas_height / 2) + (player_size / 2),
-                              z_plane);
+                              z_plane, MEM_CONFIG);
     enemy_start  = make_point(origin->x,
                               origin->y + (canvas_height / 2) + (enemy_size / 2),
-                              z_plane);
+                              z_plane, MEM_CONFIG);
 
-    player = make_cube(player_start, 25.0, player_color);
-    enemy  = make_cube(enemy_start, 25.0, enemy_color);
+    player = make_cube(player_start, 25.0, player_color, MEM_ENTITIES);
+    enemy  = make_cube(enemy_start, 25.0, enemy_color, MEM_ENTITIES);
 
     enemy_min_x = origin->x - (canvas_width / 2.0) + enemy->size / 2.0;
     enemy_max_x = origin->x + (canvas_width / 2.0) - enemy->size / 2.0;
@@ -750,39 +1214,132 @@ void init() {
     // enemy animation rate calculation
     enemy_total_dist = (canvas_height - enemy->size);
     enemy_total_time = 2.75;
-    enemy_step_dist  = (enemy_total_dist / enemy_total_time) * frame_rate;
 
     // player animation rate calculation
     player_total_dist = (canvas_width - player->size);
     player_total_time = 1.25;
-    player_step_dist  = (player_total_dist / player_total_time) * frame_rate;
 
     player_score = 0;
+    score_text   = tracked_malloc(20, MEM_HUD);
 
     is_laser_firing = 0;
+    is_shot_pending = 0;
+
+    enemy_boxes = make_box_set(1, MEM_ENTITIES);
+    enemy_hits  = make_collision_masks(enemy_boxes->capacity, MEM_ENTITIES);
+    collision_query.laser_x = tracked_malloc(sizeof(float), MEM_ENTITIES);
 
     is_game_over = 0;
 
     side_explosion_dist = 30.0;
     side_explosion_time = 0.25;
-    side_explosion_move_step = (side_explosion_dist / side_explosion_time) * frame_rate;
-
     side_explosion_total_rotation = 360.0;
-    side_explosion_rotate_step = (side_explosion_total_rotation / side_explosion_time) * frame_rate;
 
+    // The corners move 2 units per frame at 30 frames per second.
+    corner_speed = 60.0;
+    update_step_rates();
+
+    // The explosion objects are positioned by kill_enemy().
+    top_side    = make_quad(origin, origin, origin, origin, MEM_EFFECTS);
+    right_side  = make_quad(origin, origin, origin, origin, MEM_EFFECTS);
+    bottom_side = make_quad(origin, origin, origin, origin, MEM_EFFECTS);
+    left_side   = make_quad(origin, origin, origin, origin, MEM_EFFECTS);
+    front_side  = make_quad(origin, origin, origin, origin, MEM_EFFECTS);
+    back_side   = make_quad(origin, origin, origin, origin, MEM_EFFECTS);
+
+    left_top_f_corner  = make_cube(origin, 3, corner_color, MEM_EFFECTS);
+    right_top_f_corner = make_cube(origin, 3, corner_color, MEM_EFFECTS);
+    right_bot_f_corner = make_cube(origin, 3, corner_color, MEM_EFFECTS);
+    left_bot_f_corner  = make_cube(origin, 3, corner_color, MEM_EFFECTS);
+    right_top_b_corner = make_cube(origin, 3, corner_color, MEM_EFFECTS);
+    left_top_b_corner  = make_cube(origin, 3, corner_color, MEM_EFFECTS);
+    left_bot_b_corner  = make_cube(origin, 3, corner_color, MEM_EFFECTS);
+    right_bot_b_corner = make_cube(origin, 3, corner_color, MEM_EFFECTS);
+
+    is_exploding = 0;
     are_corners_visible = 0;
     corner_dist = 0;
 }
 
 
+// Reshape callback. The camera maps the playfield onto the new window
+// size and caches its matrices, which are loaded into the fixed-function
+// pipeline and, when the lit shader is in use, uploaded to it. Nothing
+// is recomputed until the window changes size again.
+void reshape(int width, int height) {
+    camera_reshape(camera, width, height);
+    camera_apply(camera);
+    if(lit_shader != NULL) {
+        lit_shader_set_projection(lit_shader, camera->projection);
+        glUseProgram(0);
+    }
+}
+
+// Sets up the lighting path once a GL context exists. The lit shader is
+// used unless fixed-function lighting was requested or the shader
+// cannot be built. The light matches the one set up by light_init().
+void init_graphics() {
+    GLfloat diff_light_value[] = {1.0, 1.0, 1.0, 1.0};
+    GLfloat ambi_light_value[] = {0.5, 0.5, 0.5, 1.0};
+    GLfloat light_position[]   = {origin->x, origin->y, origin->z, 1.0};
+
+    if(!use_fixed_function) {
+        lit_shader = make_lit_shader(MEM_CONFIG);
+        if(lit_shader == NULL) {
+            fprintf(stderr, "lit shader unavailable, using fixed-function lighting\n");
+        }
+    }
+    if(lit_shader != NULL) {
+        lit_shader_set_light(lit_shader, light_position, ambi_light_value,
+                             diff_light_value, diff_light_value);
+        glUseProgram(0);
+    }
+    glutReshapeFunc(reshape);
+}
+
+
+#ifdef BLASTER_HEADLESS
+// Stands in for the keyboard in the headless drivers: moves the player
+// toward the enemy and fires once it is lined up.
+void autopilot() {
+    float offset = enemy->center.x - player->center.x;
+
+    if(!enemy->is_alive) {
+        player->movement = 0;
+    }
+    else if(offset < -player_step_dist) {
+        player->movement = 1;
+    }
+    else if(offset > player_step_dist) {
+        player->movement = 2;
+    }
+    else {
+        player->movement = 0;
+        activate_laser();
+    }
+}
 
+// Advances the headless game by one frame on the simulated clock.
+void headless_tick() {
+    sim_time += 1000 * frame_rate;
+    run_due_timers();
+    autopilot();
+    update_game();
+}
+#else
 int main(int argc, char** argv) {
-    init();
     glutInit(&argc, argv);
+    parse_args(argc, argv);
+    if(trace_file != NULL) {
+        trace_start(trace_file);
+    }
+    init();
     my_setup(canvas_width, canvas_height, canvas_name);
-    glutDisplayFunc(initial_draw);
+    init_graphics();
+    glutDisplayFunc(display);
     glutKeyboardFunc(handle_keys);
     glutKeyboardUpFunc(handle_keys_up);
     glutMainLoop();
     return 0;
-}
\ No newline at end of file
+}
+#endif
@@ -0,0 +1,116 @@
+/***********************************************************
+
+   This header file contains the camera used by every draw path. The
+game is laid out on a fixed logical playfield (canvas_width by
+canvas_height units centered on the origin); the camera maps that
+playfield onto a window or offscreen target of any size, keeping its
+aspect ratio and centering it. The projection and view matrices are
+computed only when the target is resized and are cached here, so the
+fixed-function path loads them once per reshape and the shader path
+uploads them as uniforms instead of rebuilding them every frame.
+
+ ************************************************************/
+#ifndef CAMERA_H
+#define CAMERA_H
+
+#ifdef __APPLE__
+#  include <GLUT/glut.h>
+#else
+#  include <GL/glut.h>
+#endif
+#include "mem_track.h"
+
+// Near and far clipping planes, as used by my_3d_projection().
+#define CAMERA_FRONT_PLANE 100.0
+#define CAMERA_BACK_PLANE  -1000.0
+
+// Represents the camera and its cached matrices. The matrices are
+// column-major, as glLoadMatrixf() and glUniformMatrix4fv() expect.
+//      - The viewport is the part of the target the playfield fills.
+//      - scale is the number of pixels per playfield unit.
+typedef struct {
+    float logical_width;
+    float logical_height;
+    int target_width;
+    int target_height;
+    int viewport_x;
+    int viewport_y;
+    int viewport_width;
+    int viewport_height;
+    float scale;
+    GLfloat projection[16];
+    GLfloat view[16];
+} Camera;
+
+// Fills matrix with the same column-major orthographic projection
+// that glOrtho() would multiply onto the matrix stack.
+void ortho_matrix(GLfloat* matrix, GLfloat left, GLfloat right, GLfloat bottom,
+                  GLfloat top, GLfloat near_plane, GLfloat far_plane) {
+    int i;
+    for(i = 0; i < 16; i++) {
+        matrix[i] = 0.0;
+    }
+    matrix[0]  = 2.0 / (right - left);
+    matrix[5]  = 2.0 / (top - bottom);
+    matrix[10] = -2.0 / (far_plane - near_plane);
+    matrix[12] = -(right + left) / (right - left);
+    matrix[13] = -(top + bottom) / (top - bottom);
+    matrix[14] = -(far_plane + near_plane) / (far_plane - near_plane);
+    matrix[15] = 1.0;
+}
+
+// Recomputes the viewport and matrices for a target of the given size
+// in pixels. The playfield is scaled by the largest factor that fits
+// and centered, leaving bars on two sides when the aspect ratios
+// differ.
+void camera_reshape(Camera* camera, int width, int height) {
+    float scale_x = width / camera->logical_width;
+    float scale_y = height / camera->logical_height;
+    int i;
+
+    camera->target_width    = width;
+    camera->target_height   = height;
+    camera->scale           = scale_x < scale_y ? scale_x : scale_y;
+    camera->viewport_width  = (int)(camera->logical_width * camera->scale + 0.5);
+    camera->viewport_height = (int)(camera->logical_height * camera->scale + 0.5);
+    camera->viewport_x      = (width - camera->viewport_width) / 2;
+    camera->viewport_y      = (height - camera->viewport_height) / 2;
+
+    ortho_matrix(camera->projection,
+                 -camera->logical_width / 2, camera->logical_width / 2,
+                 -camera->logical_height / 2, camera->logical_height / 2,
+                 CAMERA_FRONT_PLANE, CAMERA_BACK_PLANE);
+
+    for(i = 0; i < 16; i++) {
+        camera->view[i] = (i % 5 == 0) ? 1.0 : 0.0;
+    }
+}
+
+// Used as a constructor to initialize a new Camera object for a
+// playfield of the given size, initially mapped onto a target of the
+// same size.
+Camera* make_camera(float logical_width, float logical_height, MemTag tag) {
+    Camera* camera = tracked_malloc(sizeof(Camera), tag);
+    camera->logical_width  = logical_width;
+    camera->logical_height = logical_height;
+    camera_reshape(camera, (int)logical_width, (int)logical_height);
+    return camera;
+}
+
+// Frees a Camera object created by make_camera().
+void destroy_camera(Camera* camera) {
+    tracked_free(camera);
+}
+
+// Loads the cached viewport and matrices into the fixed-function
+// pipeline. Only needs to be called after camera_reshape().
+void camera_apply(Camera* camera) {
+    glViewport(camera->viewport_x, camera->viewport_y,
+               camera->viewport_width, camera->viewport_height);
+    glMatrixMode(GL_PROJECTION);
+    glLoadMatrixf(camera->projection);
+    glMatrixMode(GL_MODELVIEW);
+    glLoadMatrixf(camera->view);
+}
+
+#endif
@@ -0,0 +1,487 @@
+/***********************************************************
+
+   This header file contains the frame capture pipeline used to record
+gameplay. Each frame is read back into one of two pixel buffer objects
+while the other buffer, filled during the previous frame, is mapped
+and copied out, so glReadPixels() never waits for the frame that was
+just drawn. Copied frames are handed through a bounded queue to an
+encoder thread, which writes them to disk with large buffered writes.
+When the queue is full the frame is dropped rather than stalling the
+game. A file name ending in ".y4m" is written as YUV 4:2:0 Y4M video;
+any other name gets raw top-down BGRA frames.
+
+   The frame size is fixed when the capture starts, but the window can
+be resized afterwards. Each frame is read from the part of the window
+the playfield fills. When that part is a different size from the
+capture, it is first scaled into an offscreen target with a
+framebuffer blit.
+
+   The output is declared at a fixed frame rate, but frames are drawn
+at whatever intervals the game manages, and an uncapped game draws
+them as fast as it can. Each frame is given the output frames whose
+time slots start at or after the time it was drawn and before the next
+frame was drawn: a frame drawn early is skipped, and a frame that
+stayed on screen for several slots is repeated. Playback therefore
+keeps the game's real timing.
+
+ ************************************************************/
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <pthread.h>
+#ifdef __APPLE__
+#  include <GLUT/glut.h>
+#  include <OpenGL/glext.h>
+#else
+#  include <GL/glut.h>
+#  include <GL/glext.h>
+#endif
+#include "mem_track.h"
+#include "frame_pacer.h"
+#include "offscreen.h"
+#include "trace.h"
+
+// Number of frames the queue to the encoder thread can hold.
+#define CAPTURE_QUEUE_SLOTS 8
+
+// Size of the output file's stdio buffer.
+#define CAPTURE_WRITE_BUFFER (1 << 20)
+
+// A fence placed after a readback, which signals once the readback has
+// finished. macOS's legacy OpenGL profile has APPLE_fence rather than
+// sync objects.
+#ifdef __APPLE__
+typedef GLuint CaptureFence;
+#else
+typedef GLsync CaptureFence;
+#endif
+
+// Represents a capture in progress, its queue, and its statistics.
+//      - scaled is the target frames are scaled into when the window's
+//        playfield is not the size of the capture. It is created the
+//        first time it is needed.
+//      - Readback latency is the time from issuing a frame's readback
+//        to the first check that finds its fence signaled. The fence is
+//        checked without blocking by capture_poll() and again just
+//        before mapping, so the latency is only as fine-grained as the
+//        points the game polls from.
+//      - Map stall is the time the game spent blocked in glMapBuffer()
+//        waiting for a readback to finish.
+//      - frames_emitted is the number of output frames queued so far,
+//        counting repeats; frame n of the output covers the time from
+//        start_time + n / frame_rate.
+typedef struct {
+    int width;
+    int height;
+    int is_y4m;
+    FILE* file;
+    char* write_buffer;
+
+    GLuint pixel_buffers[2];
+    CaptureFence fences[2];
+    double readback_issued[2];
+    double readback_ready[2];
+    OffscreenTarget* scaled;
+    MemTag tag;
+    int pending_buffer;
+    int has_pending;
+
+    unsigned char* slots[CAPTURE_QUEUE_SLOTS];
+    int repeats[CAPTURE_QUEUE_SLOTS];
+    unsigned char* yuv_frame;
+    int head;
+    int count;
+    int is_finishing;
+    pthread_t encoder;
+    pthread_mutex_t lock;
+    pthread_cond_t frame_ready;
+
+    int frame_rate;
+    double start_time;
+    long frames_emitted;
+
+    long frames_captured;
+    long frames_dropped;
+    long frames_skipped;
+    long frames_repeated;
+    long frames_written;
+    long latency_count;
+    double latency_sum;
+    double latency_max;
+    double map_stall_sum;
+    double map_stall_max;
+} Capture;
+
+// Clamps a color value to the 0-255 range of a byte.
+unsigned char clamp_byte(int value) {
+    return (unsigned char)(value < 0 ? 0 : (value > 255 ? 255 : value));
+}
+
+// Converts one bottom-up BGRA frame into top-down YUV 4:2:0 planes
+// using full-range BT.601 coefficients.
+void capture_bgra_to_yuv420(const unsigned char* bgra, unsigned char* yuv,
+                            int width, int height) {
+    unsigned char* y_plane = yuv;
+    unsigned char* u_plane = yuv + width * height;
+    unsigned char* v_plane = u_plane + (width / 2) * (height / 2);
+    int row, col;
+
+    for(row = 0; row < height; row++) {
+        const unsigned char* src = bgra + (size_t)(height - 1 - row) * width * 4;
+        for(col = 0; col < width; col++) {
+            int b = src[col * 4], g = src[col * 4 + 1], r = src[col * 4 + 2];
+            y_plane[row * width + col] = (unsigned char)((77 * r + 150 * g + 29 * b + 128) >> 8);
+        }
+    }
+    for(row = 0; row < height / 2; row++) {
+        const unsigned char* src = bgra + (size_t)(height - 1 - row * 2) * width * 4;
+        for(col = 0; col < width / 2; col++) {
+            int b = src[col * 8], g = src[col * 8 + 1], r = src[col * 8 + 2];
+            u_plane[row * (width / 2) + col] =
+                clamp_byte(((-43 * r - 85 * g + 128 * b + 128) >> 8) + 128);
+            v_plane[row * (width / 2) + col] =
+                clamp_byte(((128 * r - 107 * g - 21 * b + 128) >> 8) + 128);
+        }
+    }
+}
+
+// Writes one queued frame to the output file.
+void capture_write_frame(Capture* capture, const unsigned char* bgra) {
+    int row;
+
+    if(capture->is_y4m) {
+        capture_bgra_to_yuv420(bgra, capture->yuv_frame, capture->width, capture->height);
+        fputs("FRAME\n", capture->file);
+        fwrite(capture->yuv_frame, 1, capture->width * capture->height * 3 / 2, capture->file);
+    }
+    else {
+        for(row = capture->height - 1; row >= 0; row--) {
+            fwrite(bgra + (size_t)row * capture->width * 4, 1, capture->width * 4, capture->file);
+        }
+    }
+}
+
+// Encoder thread. Takes frames from the head of the queue and writes
+// them until the capture is finishing and the queue is empty.
+void* capture_encoder_main(void* arg) {
+    Capture* capture = arg;
+    int repeat;
+
+    trace_set_thread_name("capture encoder");
+    pthread_mutex_lock(&capture->lock);
+    while(1) {
+        while(capture->count == 0 && !capture->is_finishing) {
+            pthread_cond_wait(&capture->frame_ready, &capture->lock);
+        }
+        if(capture->count == 0) {
+            break;
+        }
+        pthread_mutex_unlock(&capture->lock);
+
+        TRACE_BEGIN("encode frame");
+        for(repeat = 0; repeat < capture->repeats[capture->head]; repeat++) {
+            capture_write_frame(capture, capture->slots[capture->head]);
+        }
+        TRACE_END("encode frame");
+
+        pthread_mutex_lock(&capture->lock);
+        capture->frames_written += capture->repeats[capture->head];
+        capture->head = (capture->head + 1) % CAPTURE_QUEUE_SLOTS;
+        capture->count--;
+    }
+    pthread_mutex_unlock(&capture->lock);
+    return NULL;
+}
+
+// Used as a constructor to start capturing frames of the given size
+// at the given frame rate into path. The size is rounded down to even
+// numbers for 4:2:0 output. Returns NULL if the file cannot be opened.
+Capture* make_capture(const char* path, int width, int height, int frame_rate, MemTag tag) {
+    Capture* capture;
+    size_t frame_bytes;
+    const char* extension = strrchr(path, '.');
+    FILE* file = fopen(path, "wb");
+    int i;
+
+    if(file == NULL) {
+        perror(path);
+        return NULL;
+    }
+
+    capture = tracked_calloc(1, sizeof(Capture), tag);
+    capture->width  = width & ~1;
+    capture->height = height & ~1;
+    capture->is_y4m = extension != NULL && strcmp(extension, ".y4m") == 0;
+    capture->file   = file;
+    capture->tag    = tag;
+    capture->frame_rate = frame_rate;
+    capture->write_buffer = tracked_malloc(CAPTURE_WRITE_BUFFER, tag);
+    setvbuf(file, capture->write_buffer, _IOFBF, CAPTURE_WRITE_BUFFER);
+
+    frame_bytes = (size_t)capture->width * capture->height * 4;
+    for(i = 0; i < CAPTURE_QUEUE_SLOTS; i++) {
+        capture->slots[i] = tracked_malloc(frame_bytes, tag);
+    }
+    if(capture->is_y4m) {
+        capture->yuv_frame = tracked_malloc(capture->width * capture->height * 3 / 2, tag);
+        fprintf(file, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C420jpeg\n",
+                capture->width, capture->height, frame_rate);
+    }
+
+#ifdef __APPLE__
+    glGenFencesAPPLE(2, capture->fences);
+#endif
+    glGenBuffers(2, capture->pixel_buffers);
+    for(i = 0; i < 2; i++) {
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, capture->pixel_buffers[i]);
+        glBufferData(GL_PIXEL_PACK_BUFFER, frame_bytes, NULL, GL_STREAM_READ);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    pthread_mutex_init(&capture->lock, NULL);
+    pthread_cond_init(&capture->frame_ready, NULL);
+    pthread_create(&capture->encoder, NULL, capture_encoder_main, capture);
+    return capture;
+}
+
+// Places a fence after the readback just issued into buffer.
+void capture_set_fence(Capture* capture, int buffer) {
+#ifdef __APPLE__
+    glSetFenceAPPLE(capture->fences[buffer]);
+#else
+    if(capture->fences[buffer] != NULL) {
+        glDeleteSync(capture->fences[buffer]);
+    }
+    capture->fences[buffer] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+#endif
+    capture->readback_issued[buffer] = pacer_now();
+    capture->readback_ready[buffer]  = 0.0;
+}
+
+// Returns 1 if the readback into buffer has finished, without waiting.
+int capture_test_fence(Capture* capture, int buffer) {
+#ifdef __APPLE__
+    return glTestFenceAPPLE(capture->fences[buffer]);
+#else
+    GLenum status = glClientWaitSync(capture->fences[buffer], GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+    return status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED;
+#endif
+}
+
+// Checks, without blocking, whether the pending readback has finished,
+// and records when it was first seen to have. Calling this at a few
+// points during each frame makes the readback latency more precise.
+void capture_poll(Capture* capture) {
+    int buffer = capture->pending_buffer;
+
+    if(capture->has_pending && capture->readback_ready[buffer] == 0.0 &&
+       capture_test_fence(capture, buffer)) {
+        capture->readback_ready[buffer] = pacer_now();
+    }
+}
+
+// Returns the number of output frames a frame drawn at draw_time should
+// fill: the slots that have started since the last frame queued. A
+// result of 0 means the frame was drawn before the next slot started.
+long capture_frames_due(Capture* capture, double draw_time) {
+    if(capture->frames_emitted == 0 && capture->start_time == 0.0) {
+        capture->start_time = draw_time;
+    }
+    return (long)floor((draw_time - capture->start_time) * capture->frame_rate) + 1 -
+           capture->frames_emitted;
+}
+
+// Maps the pending pixel buffer and queues its frame for the encoder,
+// as many times as the output frame rate needs. The frame is skipped if
+// no output slot has started since the last one, and dropped if the
+// queue is full; in either case the next frame queued fills the gap.
+void capture_collect(Capture* capture) {
+    int buffer = capture->pending_buffer;
+    double start, stall, latency;
+    unsigned char* pixels;
+    int slot = -1;
+    long due;
+
+    capture_poll(capture);
+    start = pacer_now();
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, capture->pixel_buffers[buffer]);
+    pixels = glMapBuffer(GL_PIXEL_PACK_BUFFER, GL_READ_ONLY);
+    stall = pacer_now() - start;
+
+    // A readback that had not finished by the last check finished while
+    // glMapBuffer() waited for it.
+    if(capture->readback_ready[buffer] == 0.0) {
+        capture->readback_ready[buffer] = start + stall;
+    }
+    latency = capture->readback_ready[buffer] - capture->readback_issued[buffer];
+    capture->latency_sum += latency;
+    capture->latency_count++;
+    if(latency > capture->latency_max) {
+        capture->latency_max = latency;
+    }
+
+    due = capture_frames_due(capture, capture->readback_issued[buffer]);
+    pthread_mutex_lock(&capture->lock);
+    if(capture->count < CAPTURE_QUEUE_SLOTS) {
+        slot = (capture->head + capture->count) % CAPTURE_QUEUE_SLOTS;
+    }
+    pthread_mutex_unlock(&capture->lock);
+
+    if(pixels != NULL && due <= 0) {
+        capture->frames_skipped++;
+    }
+    else if(pixels != NULL && slot >= 0) {
+        memcpy(capture->slots[slot], pixels, (size_t)capture->width * capture->height * 4);
+        capture->repeats[slot] = (int)due;
+        capture->frames_emitted  += due;
+        capture->frames_repeated += due - 1;
+        pthread_mutex_lock(&capture->lock);
+        capture->count++;
+        pthread_cond_signal(&capture->frame_ready);
+        pthread_mutex_unlock(&capture->lock);
+        capture->frames_captured++;
+    }
+    else {
+        capture->frames_dropped++;
+    }
+    if(pixels != NULL) {
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    capture->map_stall_sum += stall;
+    if(stall > capture->map_stall_max) {
+        capture->map_stall_max = stall;
+    }
+    capture->has_pending = 0;
+}
+
+// Scales the given rectangle of the back buffer into the capture's
+// offscreen target and leaves that target bound for reading. Returns
+// 0 if the target cannot be created.
+int capture_scale_region(Capture* capture, int x, int y, int width, int height) {
+    if(capture->scaled == NULL) {
+        capture->scaled = make_offscreen_target(capture->width, capture->height, capture->tag);
+        if(capture->scaled == NULL) {
+            return 0;
+        }
+    }
+    glBindFramebufferEXT(GL_READ_FRAMEBUFFER_EXT, 0);
+    glReadBuffer(GL_BACK);
+    glBindFramebufferEXT(GL_DRAW_FRAMEBUFFER_EXT, capture->scaled->framebuffer);
+    glBlitFramebufferEXT(x, y, x + width, y + height,
+                         0, 0, capture->width, capture->height,
+                         GL_COLOR_BUFFER_BIT, GL_LINEAR);
+    glBindFramebufferEXT(GL_FRAMEBUFFER_EXT, capture->scaled->framebuffer);
+    glReadBuffer(GL_COLOR_ATTACHMENT0_EXT);
+    return 1;
+}
+
+// Captures the frame that has just been drawn, from the given rectangle
+// of the window. Must be called before the buffers are swapped. The
+// readback is started into one pixel buffer, and the previous frame is
+// collected from the other.
+void capture_frame(Capture* capture, int x, int y, int width, int height) {
+    int buffer = capture->has_pending ? 1 - capture->pending_buffer : 0;
+    int is_scaled = width != capture->width || height != capture->height;
+
+    TRACE_BEGIN("capture_frame");
+    if(is_scaled && !capture_scale_region(capture, x, y, width, height)) {
+        capture->frames_dropped++;
+        TRACE_END("capture_frame");
+        return;
+    }
+    if(!is_scaled) {
+        glReadBuffer(GL_BACK);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, capture->pixel_buffers[buffer]);
+    glReadPixels(is_scaled ? 0 : x, is_scaled ? 0 : y, capture->width, capture->height,
+                 GL_BGRA, GL_UNSIGNED_BYTE, 0);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    capture_set_fence(capture, buffer);
+    if(is_scaled) {
+        bind_offscreen_target(NULL);
+        glReadBuffer(GL_BACK);
+    }
+
+    if(capture->has_pending) {
+        capture_collect(capture);
+    }
+    capture->pending_buffer = buffer;
+    capture->has_pending    = 1;
+    TRACE_END("capture_frame");
+}
+
+// Collects the last pending frame, waits for the encoder to write every
+// queued frame, and closes the file. No frames can be captured after
+// this is called.
+void capture_finish(Capture* capture) {
+    if(capture->has_pending) {
+        capture_collect(capture);
+    }
+
+    pthread_mutex_lock(&capture->lock);
+    capture->is_finishing = 1;
+    pthread_cond_signal(&capture->frame_ready);
+    pthread_mutex_unlock(&capture->lock);
+    pthread_join(capture->encoder, NULL);
+    fclose(capture->file);
+    capture->file = NULL;
+}
+
+// Prints the capture statistics. The number of frames written is only
+// final after capture_finish().
+void capture_report(Capture* capture, FILE* out) {
+    pthread_mutex_lock(&capture->lock);
+    fprintf(out, "capture: %ld frames written at %d fps  %ld repeated  %ld skipped  "
+                 "%ld dropped\n",
+            capture->frames_written, capture->frame_rate, capture->frames_repeated,
+            capture->frames_skipped, capture->frames_dropped);
+    pthread_mutex_unlock(&capture->lock);
+    if(capture->latency_count > 0) {
+        fprintf(out, "readback latency: mean %.3f ms  max %.3f ms  "
+                     "map stall: mean %.3f ms  max %.3f ms\n",
+                capture->latency_sum * 1000.0 / capture->latency_count,
+                capture->latency_max * 1000.0,
+                capture->map_stall_sum * 1000.0 / capture->latency_count,
+                capture->map_stall_max * 1000.0);
+    }
+}
+
+// Frees a Capture object created by make_capture(), finishing the
+// capture first if that has not been done.
+void destroy_capture(Capture* capture) {
+    int i;
+
+    if(capture->file != NULL) {
+        capture_finish(capture);
+    }
+    pthread_mutex_destroy(&capture->lock);
+    pthread_cond_destroy(&capture->frame_ready);
+
+    glDeleteBuffers(2, capture->pixel_buffers);
+#ifdef __APPLE__
+    glDeleteFencesAPPLE(2, capture->fences);
+#else
+    for(i = 0; i < 2; i++) {
+        if(capture->fences[i] != NULL) {
+            glDeleteSync(capture->fences[i]);
+        }
+    }
+#endif
+    if(capture->scaled != NULL) {
+        destroy_offscreen_target(capture->scaled);
+    }
+    for(i = 0; i < CAPTURE_QUEUE_SLOTS; i++) {
+        tracked_free(capture->slots[i]);
+    }
+    tracked_free(capture->yuv_frame);
+    tracked_free(capture->write_buffer);
+    tracked_free(capture);
+}
+
+#endif
@@ -0,0 +1,243 @@
+/***********************************************************
+
+   This header file contains the batch collision kernel used by the
+game loop. Boxes are stored as a structure of arrays (center x, center y
+and half size) so that a whole set can be tested against the frame's
+query shapes (laser columns, the player box and the canvas bottom edge)
+in one pass. When the compiler targets AVX2 or SSE2 the boxes are
+tested eight or four at a time with branch-free min/max comparisons;
+collide_boxes_scalar() is the reference the SIMD path must agree with.
+
+ ************************************************************/
+#ifndef COLLISION_H
+#define COLLISION_H
+
+#include <stdlib.h>
+#include <math.h>
+#include "mem_track.h"
+#if defined(__AVX2__) || defined(__SSE2__)
+#  include <immintrin.h>
+#endif
+
+// A structure of arrays holding a set of axis-aligned boxes.
+typedef struct {
+    float* center_x;
+    float* center_y;
+    float* half_size;
+    int count;
+    int capacity;
+} BoxSet;
+
+// The shapes each box is tested against during a collision pass.
+//      - laser_x holds the x position of each vertical laser column.
+//      - The player box is given by its center and half size.
+//      - bottom_y is the y position of the bottom edge of the canvas.
+typedef struct {
+    float* laser_x;
+    int laser_count;
+    float player_x;
+    float player_y;
+    float player_half_size;
+    float bottom_y;
+} CollisionQuery;
+
+// Per-box results of a collision pass. Entry i of each array is 1 if
+// box i hit the corresponding query shape and 0 otherwise.
+typedef struct {
+    unsigned char* laser;
+    unsigned char* player;
+    unsigned char* bottom;
+} CollisionMasks;
+
+// Used as a constructor to initialize a new, empty BoxSet object.
+BoxSet* make_box_set(int capacity, MemTag tag) {
+    BoxSet* set    = tracked_malloc(sizeof(BoxSet), tag);
+    set->center_x  = tracked_malloc(capacity * sizeof(float), tag);
+    set->center_y  = tracked_malloc(capacity * sizeof(float), tag);
+    set->half_size = tracked_malloc(capacity * sizeof(float), tag);
+    set->count     = 0;
+    set->capacity  = capacity;
+    return set;
+}
+
+// Frees a BoxSet object created by make_box_set().
+void destroy_box_set(BoxSet* set) {
+    tracked_free(set->center_x);
+    tracked_free(set->center_y);
+    tracked_free(set->half_size);
+    tracked_free(set);
+}
+
+// Used as a constructor to initialize the mask arrays for a BoxSet
+// of the given capacity.
+CollisionMasks make_collision_masks(int capacity, MemTag tag) {
+    CollisionMasks masks;
+    masks.laser  = tracked_calloc(capacity, sizeof(unsigned char), tag);
+    masks.player = tracked_calloc(capacity, sizeof(unsigned char), tag);
+    masks.bottom = tracked_calloc(capacity, sizeof(unsigned char), tag);
+    return masks;
+}
+
+// Frees the mask arrays created by make_collision_masks().
+void destroy_collision_masks(CollisionMasks* masks) {
+    tracked_free(masks->laser);
+    tracked_free(masks->player);
+    tracked_free(masks->bottom);
+}
+
+// Removes every box from the set.
+void box_set_clear(BoxSet* set) {
+    set->count = 0;
+}
+
+// Appends a box to the set. Returns the index of the new box, or -1
+// if the set is full.
+int box_set_add(BoxSet* set, float center_x, float center_y, float size) {
+    if(set->count >= set->capacity) {
+        return -1;
+    }
+    set->center_x[set->count]  = center_x;
+    set->center_y[set->count]  = center_y;
+    set->half_size[set->count] = size / 2;
+    return set->count++;
+}
+
+// Tests boxes [start, end) one at a time. The comparisons are combined
+// with bitwise operators so that no branches depend on the box data.
+void collide_box_range_scalar(const BoxSet* set, const CollisionQuery* query,
+                              CollisionMasks* masks, int start, int end) {
+    float player_lo_x = query->player_x - query->player_half_size;
+    float player_hi_x = query->player_x + query->player_half_size;
+    float player_lo_y = query->player_y - query->player_half_size;
+    float player_hi_y = query->player_y + query->player_half_size;
+    int i, j;
+
+    for(i = start; i < end; i++) {
+        float lo_x = set->center_x[i] - set->half_size[i];
+        float hi_x = set->center_x[i] + set->half_size[i];
+        float lo_y = set->center_y[i] - set->half_size[i];
+        float hi_y = set->center_y[i] + set->half_size[i];
+        int laser_hit = 0;
+
+        for(j = 0; j < query->laser_count; j++) {
+            laser_hit |= (query->laser_x[j] > lo_x) & (query->laser_x[j] < hi_x);
+        }
+
+        masks->laser[i]  = (unsigned char)laser_hit;
+        masks->player[i] = (unsigned char)((fmaxf(lo_x, player_lo_x) < fminf(hi_x, player_hi_x)) &
+                                           (fmaxf(lo_y, player_lo_y) < fminf(hi_y, player_hi_y)));
+        masks->bottom[i] = (unsigned char)(lo_y < query->bottom_y);
+    }
+}
+
+// Reference implementation of the collision pass.
+void collide_boxes_scalar(const BoxSet* set, const CollisionQuery* query,
+                          CollisionMasks* masks) {
+    collide_box_range_scalar(set, query, masks, 0, set->count);
+}
+
+// Expands the low bits of a movemask result into one byte per box.
+void store_mask_bits(unsigned char* mask, int bits, int width) {
+    int k;
+    for(k = 0; k < width; k++) {
+        mask[k] = (unsigned char)((bits >> k) & 1);
+    }
+}
+
+#if defined(__AVX2__)
+
+// Tests eight boxes per iteration using AVX comparisons.
+void collide_boxes(const BoxSet* set, const CollisionQuery* query,
+                   CollisionMasks* masks) {
+    __m256 player_lo_x = _mm256_set1_ps(query->player_x - query->player_half_size);
+    __m256 player_hi_x = _mm256_set1_ps(query->player_x + query->player_half_size);
+    __m256 player_lo_y = _mm256_set1_ps(query->player_y - query->player_half_size);
+    __m256 player_hi_y = _mm256_set1_ps(query->player_y + query->player_half_size);
+    __m256 bottom_y    = _mm256_set1_ps(query->bottom_y);
+    int i, j;
+
+    for(i = 0; i + 8 <= set->count; i += 8) {
+        __m256 center_x = _mm256_loadu_ps(set->center_x + i);
+        __m256 center_y = _mm256_loadu_ps(set->center_y + i);
+        __m256 half     = _mm256_loadu_ps(set->half_size + i);
+        __m256 lo_x = _mm256_sub_ps(center_x, half);
+        __m256 hi_x = _mm256_add_ps(center_x, half);
+        __m256 lo_y = _mm256_sub_ps(center_y, half);
+        __m256 hi_y = _mm256_add_ps(center_y, half);
+        __m256 laser_hit = _mm256_setzero_ps();
+        __m256 player_hit, bottom_hit;
+
+        for(j = 0; j < query->laser_count; j++) {
+            __m256 laser_x = _mm256_set1_ps(query->laser_x[j]);
+            laser_hit = _mm256_or_ps(laser_hit,
+                _mm256_and_ps(_mm256_cmp_ps(laser_x, lo_x, _CMP_GT_OQ),
+                              _mm256_cmp_ps(laser_x, hi_x, _CMP_LT_OQ)));
+        }
+
+        player_hit = _mm256_and_ps(
+            _mm256_cmp_ps(_mm256_max_ps(lo_x, player_lo_x),
+                          _mm256_min_ps(hi_x, player_hi_x), _CMP_LT_OQ),
+            _mm256_cmp_ps(_mm256_max_ps(lo_y, player_lo_y),
+                          _mm256_min_ps(hi_y, player_hi_y), _CMP_LT_OQ));
+        bottom_hit = _mm256_cmp_ps(lo_y, bottom_y, _CMP_LT_OQ);
+
+        store_mask_bits(masks->laser + i,  _mm256_movemask_ps(laser_hit), 8);
+        store_mask_bits(masks->player + i, _mm256_movemask_ps(player_hit), 8);
+        store_mask_bits(masks->bottom + i, _mm256_movemask_ps(bottom_hit), 8);
+    }
+    collide_box_range_scalar(set, query, masks, i, set->count);
+}
+
+#elif defined(__SSE2__)
+
+// Tests four boxes per iteration using SSE comparisons.
+void collide_boxes(const BoxSet* set, const CollisionQuery* query,
+                   CollisionMasks* masks) {
+    __m128 player_lo_x = _mm_set1_ps(query->player_x - query->player_half_size);
+    __m128 player_hi_x = _mm_set1_ps(query->player_x + query->player_half_size);
+    __m128 player_lo_y = _mm_set1_ps(query->player_y - query->player_half_size);
+    __m128 player_hi_y = _mm_set1_ps(query->player_y + query->player_half_size);
+    __m128 bottom_y    = _mm_set1_ps(query->bottom_y);
+    int i, j;
+
+    for(i = 0; i + 4 <= set->count; i += 4) {
+        __m128 center_x = _mm_loadu_ps(set->center_x + i);
+        __m128 center_y = _mm_loadu_ps(set->center_y + i);
+        __m128 half     = _mm_loadu_ps(set->half_size + i);
+        __m128 lo_x = _mm_sub_ps(center_x, half);
+        __m128 hi_x = _mm_add_ps(center_x, half);
+        __m128 lo_y = _mm_sub_ps(center_y, half);
+        __m128 hi_y = _mm_add_ps(center_y, half);
+        __m128 laser_hit = _mm_setzero_ps();
+        __m128 player_hit, bottom_hit;
+
+        for(j = 0; j < query->laser_count; j++) {
+            __m128 laser_x = _mm_set1_ps(query->laser_x[j]);
+            laser_hit = _mm_or_ps(laser_hit,
+                _mm_and_ps(_mm_cmpgt_ps(laser_x, lo_x),
+                           _mm_cmplt_ps(laser_x, hi_x)));
+        }
+
+        player_hit = _mm_and_ps(
+            _mm_cmplt_ps(_mm_max_ps(lo_x, player_lo_x), _mm_min_ps(hi_x, player_hi_x)),
+            _mm_cmplt_ps(_mm_max_ps(lo_y, player_lo_y), _mm_min_ps(hi_y, player_hi_y)));
+        bottom_hit = _mm_cmplt_ps(lo_y, bottom_y);
+
+        store_mask_bits(masks->laser + i,  _mm_movemask_ps(laser_hit), 4);
+        store_mask_bits(masks->player + i, _mm_movemask_ps(player_hit), 4);
+        store_mask_bits(masks->bottom + i, _mm_movemask_ps(bottom_hit), 4);
+    }
+    collide_box_range_scalar(set, query, masks, i, set->count);
+}
+
+#else
+
+// No SIMD instruction set available; fall back to the reference pass.
+void collide_boxes(const BoxSet* set, const CollisionQuery* query,
+                   CollisionMasks* masks) {
+    collide_boxes_scalar(set, query, masks);
+}
+
+#endif
+
+#endif
@@ -0,0 +1,185 @@
+/***********************************************************
+
+   This header file contains the frame pacer used by the animation
+loop. The pacer measures the real interval between buffer swaps on a
+monotonic clock, waits out the rest of each frame by sleeping until
+shortly before the deadline and spinning for the remainder, and keeps
+running jitter statistics. When frames overrun their deadline the pacer
+lowers its quality level so the game can draw less; once frames are
+back on time the quality level is raised again.
+
+ ************************************************************/
+#ifndef FRAME_PACER_H
+#define FRAME_PACER_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <time.h>
+#include "mem_track.h"
+
+// Highest quality level the pacer will report.
+#define FRAME_QUALITY_MAX 2
+
+// Time left before a deadline that is spun rather than slept, since
+// sleeps may wake up late by roughly a scheduler tick.
+#define FRAME_SPIN_MARGIN 0.002
+
+// Number of frames over which overruns are counted before the quality
+// level is adjusted.
+#define FRAME_QUALITY_WINDOW 30
+
+// Represents the frame pacer state and its running statistics.
+//      A target_interval of 0 means the frame rate is uncapped.
+typedef struct {
+    double target_interval;
+    double next_deadline;
+    double last_swap;
+    double last_interval;
+
+    long frame_count;
+    long overrun_count;
+    double interval_sum;
+    double interval_sq_sum;
+    double interval_min;
+    double interval_max;
+
+    int quality;
+    int window_frames;
+    int window_overruns;
+} FramePacer;
+
+// Returns the current time of the monotonic clock in seconds.
+double pacer_now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Used as a constructor to initialize a new FramePacer object. A
+// target_rate of 0 leaves the frame rate uncapped.
+FramePacer* make_frame_pacer(int target_rate, MemTag tag) {
+    FramePacer* pacer = tracked_calloc(1, sizeof(FramePacer), tag);
+    pacer->target_interval = target_rate > 0 ? 1.0 / target_rate : 0.0;
+    pacer->next_deadline   = pacer_now() + pacer->target_interval;
+    pacer->quality         = FRAME_QUALITY_MAX;
+    return pacer;
+}
+
+// Changes the target frame rate, restarting the frame schedule from
+// now. A target_rate of 0 leaves the frame rate uncapped.
+void frame_pacer_set_rate(FramePacer* pacer, int target_rate) {
+    pacer->target_interval = target_rate > 0 ? 1.0 / target_rate : 0.0;
+    pacer->next_deadline   = pacer_now() + pacer->target_interval;
+}
+
+// Frees a FramePacer object created by make_frame_pacer().
+void destroy_frame_pacer(FramePacer* pacer) {
+    tracked_free(pacer);
+}
+
+// Records a buffer swap. Must be called immediately after
+// glutSwapBuffers() so that the measured interval is swap-to-swap.
+void frame_pacer_mark_swap(FramePacer* pacer) {
+    double now = pacer_now();
+    double interval;
+
+    if(pacer->last_swap == 0.0) {
+        pacer->last_swap = now;
+        return;
+    }
+    interval = now - pacer->last_swap;
+    pacer->last_swap     = now;
+    pacer->last_interval = interval;
+
+    if(pacer->frame_count == 0 || interval < pacer->interval_min) {
+        pacer->interval_min = interval;
+    }
+    if(interval > pacer->interval_max) {
+        pacer->interval_max = interval;
+    }
+    pacer->frame_count++;
+    pacer->interval_sum    += interval;
+    pacer->interval_sq_sum += interval * interval;
+
+    // A frame counts as overrun once it is more than 10% late.
+    if(pacer->target_interval > 0.0 && interval > pacer->target_interval * 1.1) {
+        pacer->overrun_count++;
+        pacer->window_overruns++;
+    }
+
+    if(++pacer->window_frames == FRAME_QUALITY_WINDOW) {
+        if(pacer->window_overruns > FRAME_QUALITY_WINDOW / 10 && pacer->quality > 0) {
+            pacer->quality--;
+        }
+        else if(pacer->window_overruns == 0 && pacer->quality < FRAME_QUALITY_MAX) {
+            pacer->quality++;
+        }
+        pacer->window_frames   = 0;
+        pacer->window_overruns = 0;
+    }
+}
+
+// Blocks until the next frame deadline. Most of the wait is slept and
+// the final FRAME_SPIN_MARGIN is spun on the clock. If the deadline has
+// already passed, the schedule restarts from now instead of rushing
+// frames to catch up.
+void frame_pacer_wait(FramePacer* pacer) {
+    double now = pacer_now();
+    double remaining;
+
+    if(pacer->target_interval == 0.0) {
+        return;
+    }
+
+    remaining = pacer->next_deadline - now - FRAME_SPIN_MARGIN;
+    if(remaining > 0.0) {
+        struct timespec ts;
+        ts.tv_sec  = (time_t)remaining;
+        ts.tv_nsec = (long)((remaining - ts.tv_sec) * 1e9);
+        nanosleep(&ts, NULL);
+    }
+    while(pacer_now() < pacer->next_deadline) {
+        // Spin for the last part of the frame.
+    }
+
+    now = pacer_now();
+    pacer->next_deadline += pacer->target_interval;
+    if(pacer->next_deadline < now) {
+        pacer->next_deadline = now + pacer->target_interval;
+    }
+}
+
+// Returns the mean swap-to-swap interval in seconds.
+double frame_pacer_mean(FramePacer* pacer) {
+    if(pacer->frame_count == 0) {
+        return 0.0;
+    }
+    return pacer->interval_sum / pacer->frame_count;
+}
+
+// Returns the frame time jitter, the standard deviation of the
+// swap-to-swap interval, in seconds.
+double frame_pacer_jitter(FramePacer* pacer) {
+    double mean, variance;
+
+    if(pacer->frame_count == 0) {
+        return 0.0;
+    }
+    mean     = frame_pacer_mean(pacer);
+    variance = pacer->interval_sq_sum / pacer->frame_count - mean * mean;
+    return variance > 0.0 ? sqrt(variance) : 0.0;
+}
+
+// Prints the frame time statistics gathered so far.
+void frame_pacer_report(FramePacer* pacer, FILE* out) {
+    double mean = frame_pacer_mean(pacer);
+
+    fprintf(out, "frames: %ld  mean: %.2f ms (%.1f fps)  min: %.2f ms  max: %.2f ms\n",
+            pacer->frame_count, mean * 1000.0, mean > 0.0 ? 1.0 / mean : 0.0,
+            pacer->interval_min * 1000.0, pacer->interval_max * 1000.0);
+    fprintf(out, "jitter: %.3f ms  overruns: %ld  quality: %d\n",
+            frame_pacer_jitter(pacer) * 1000.0, pacer->overrun_count, pacer->quality);
+}
+
+#endif
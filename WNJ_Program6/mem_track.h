@@ -0,0 +1,112 @@
+/***********************************************************
+
+   This header file contains the tracked allocator used for every
+object the game creates. Each allocation is tagged with the subsystem
+that owns it, and the live and peak byte counts are kept per tag and in
+total so that the frame statistics overlay and the soak driver can show
+whether memory is growing.
+
+ ************************************************************/
+#ifndef MEM_TRACK_H
+#define MEM_TRACK_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// The subsystems that allocations are charged to.
+typedef enum {
+    MEM_ENTITIES,
+    MEM_EFFECTS,
+    MEM_HUD,
+    MEM_CONFIG,
+    MEM_CAPTURE,
+    MEM_TRACE,
+    MEM_TAG_COUNT
+} MemTag;
+
+// Header stored in front of every tracked allocation. The union keeps
+// the memory handed back to the caller suitably aligned for any of the
+// basic types (max_align_t is not available in C99).
+typedef union {
+    struct {
+        size_t size;
+        MemTag tag;
+    } info;
+    long double align_float;
+    long long align_int;
+    void* align_pointer;
+} MemHeader;
+
+// Live and peak byte counts for each tag and for all tags combined,
+// and the number of allocations that have not been freed.
+size_t mem_live_bytes[MEM_TAG_COUNT];
+size_t mem_peak_bytes[MEM_TAG_COUNT];
+size_t mem_total_live_bytes;
+size_t mem_total_peak_bytes;
+long mem_live_allocs;
+
+// Returns the printable name of a tag.
+const char* mem_tag_name(MemTag tag) {
+    static const char* names[MEM_TAG_COUNT] = { "entities", "effects", "hud", "config", "capture", "trace" };
+    return names[tag];
+}
+
+// Allocates size bytes and charges them to tag. Returns NULL if the
+// allocation fails.
+void* tracked_malloc(size_t size, MemTag tag) {
+    MemHeader* header = malloc(sizeof(MemHeader) + size);
+    if(header == NULL) {
+        return NULL;
+    }
+    header->info.size = size;
+    header->info.tag  = tag;
+
+    mem_live_bytes[tag] += size;
+    if(mem_live_bytes[tag] > mem_peak_bytes[tag]) {
+        mem_peak_bytes[tag] = mem_live_bytes[tag];
+    }
+    mem_total_live_bytes += size;
+    if(mem_total_live_bytes > mem_total_peak_bytes) {
+        mem_total_peak_bytes = mem_total_live_bytes;
+    }
+    mem_live_allocs++;
+
+    return header + 1;
+}
+
+// Allocates count zeroed elements of size bytes and charges them to tag.
+void* tracked_calloc(size_t count, size_t size, MemTag tag) {
+    void* ptr = tracked_malloc(count * size, tag);
+    if(ptr != NULL) {
+        memset(ptr, 0, count * size);
+    }
+    return ptr;
+}
+
+// Frees memory returned by tracked_malloc() or tracked_calloc() and
+// credits it back to its tag. Passing NULL does nothing.
+void tracked_free(void* ptr) {
+    MemHeader* header;
+    if(ptr == NULL) {
+        return;
+    }
+    header = (MemHeader*)ptr - 1;
+    mem_live_bytes[header->info.tag] -= header->info.size;
+    mem_total_live_bytes -= header->info.size;
+    mem_live_allocs--;
+    free(header);
+}
+
+// Prints the live and peak byte counts for every tag.
+void mem_report(FILE* out) {
+    int tag;
+    for(tag = 0; tag < MEM_TAG_COUNT; tag++) {
+        fprintf(out, "%-9s live: %6zu B  peak: %6zu B\n",
+                mem_tag_name(tag), mem_live_bytes[tag], mem_peak_bytes[tag]);
+    }
+    fprintf(out, "%-9s live: %6zu B  peak: %6zu B  allocations: %ld\n",
+            "total", mem_total_live_bytes, mem_total_peak_bytes, mem_live_allocs);
+}
+
+#endif
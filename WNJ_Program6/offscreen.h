@@ -0,0 +1,70 @@
+/***********************************************************
+
+   This header file contains the offscreen render target used by the
+benchmarks and by the capture pipeline. A target is a framebuffer
+object with a color renderbuffer of any size, so frames can be drawn,
+timed, or scaled without depending on the size of the window or on
+the display's swap rate.
+
+ ************************************************************/
+#ifndef OFFSCREEN_H
+#define OFFSCREEN_H
+
+#ifdef __APPLE__
+#  include <GLUT/glut.h>
+#  include <OpenGL/glext.h>
+#else
+#  include <GL/glut.h>
+#  include <GL/glext.h>
+#endif
+#include "mem_track.h"
+
+// Represents a framebuffer object and the renderbuffer it draws into.
+typedef struct {
+    GLuint framebuffer;
+    GLuint color_buffer;
+    int width;
+    int height;
+} OffscreenTarget;
+
+// Used as a constructor to initialize a new OffscreenTarget object.
+// Returns NULL if the framebuffer cannot be completed at this size.
+OffscreenTarget* make_offscreen_target(int width, int height, MemTag tag) {
+    OffscreenTarget* target = tracked_malloc(sizeof(OffscreenTarget), tag);
+    target->width  = width;
+    target->height = height;
+
+    glGenFramebuffersEXT(1, &target->framebuffer);
+    glGenRenderbuffersEXT(1, &target->color_buffer);
+
+    glBindRenderbufferEXT(GL_RENDERBUFFER_EXT, target->color_buffer);
+    glRenderbufferStorageEXT(GL_RENDERBUFFER_EXT, GL_RGBA8, width, height);
+    glBindFramebufferEXT(GL_FRAMEBUFFER_EXT, target->framebuffer);
+    glFramebufferRenderbufferEXT(GL_FRAMEBUFFER_EXT, GL_COLOR_ATTACHMENT0_EXT,
+                                 GL_RENDERBUFFER_EXT, target->color_buffer);
+
+    if(glCheckFramebufferStatusEXT(GL_FRAMEBUFFER_EXT) != GL_FRAMEBUFFER_COMPLETE_EXT) {
+        glBindFramebufferEXT(GL_FRAMEBUFFER_EXT, 0);
+        glDeleteRenderbuffersEXT(1, &target->color_buffer);
+        glDeleteFramebuffersEXT(1, &target->framebuffer);
+        tracked_free(target);
+        return NULL;
+    }
+    glBindFramebufferEXT(GL_FRAMEBUFFER_EXT, 0);
+    return target;
+}
+
+// Frees an OffscreenTarget object created by make_offscreen_target().
+void destroy_offscreen_target(OffscreenTarget* target) {
+    glDeleteRenderbuffersEXT(1, &target->color_buffer);
+    glDeleteFramebuffersEXT(1, &target->framebuffer);
+    tracked_free(target);
+}
+
+// Directs drawing into the target. Passing NULL directs drawing back
+// to the window.
+void bind_offscreen_target(OffscreenTarget* target) {
+    glBindFramebufferEXT(GL_FRAMEBUFFER_EXT, target != NULL ? target->framebuffer : 0);
+}
+
+#endif
@@ -0,0 +1,192 @@
+/***********************************************************
+
+   This header file contains the GLSL lighting path. A single lit
+shader reproduces the fixed-function lighting set up by light_init():
+one positional light, a local viewer, and per-vertex ambient, diffuse
+and specular terms. The orthographic projection is passed in as a
+uniform from the camera, so it is only uploaded when the window is
+reshaped, and each material is a group of uniforms set once per
+object class.
+
+   The shaders are written against GLSL 1.20 so that they run in the
+compatibility context GLUT creates on every platform; the GLUT cube
+and bitmap text calls the game relies on are not available in a core
+profile context. If the shader cannot be built, make_lit_shader()
+returns NULL and the game keeps using fixed-function lighting.
+
+ ************************************************************/
+#ifndef SHADER_H
+#define SHADER_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#ifdef __APPLE__
+#  include <GLUT/glut.h>
+#  include <OpenGL/glext.h>
+#else
+#  include <GL/glut.h>
+#  include <GL/glext.h>
+#endif
+#include "mem_track.h"
+
+// Represents a surface material in the layout both lighting paths use.
+typedef struct {
+    GLfloat ambient[4];
+    GLfloat diffuse[4];
+    GLfloat specular[4];
+    GLfloat shininess;
+} Material;
+
+// Represents the lit shader program and its uniform locations.
+typedef struct {
+    GLuint program;
+    GLint projection;
+    GLint light_position;
+    GLint light_ambient;
+    GLint light_diffuse;
+    GLint light_specular;
+    GLint material_ambient;
+    GLint material_diffuse;
+    GLint material_specular;
+    GLint material_shininess;
+} LitShader;
+
+static const char* lit_vertex_source =
+    "#version 120\n"
+    "uniform mat4 projection;\n"
+    "uniform vec4 light_position;\n"
+    "uniform vec4 light_ambient;\n"
+    "uniform vec4 light_diffuse;\n"
+    "uniform vec4 light_specular;\n"
+    "uniform vec4 material_ambient;\n"
+    "uniform vec4 material_diffuse;\n"
+    "uniform vec4 material_specular;\n"
+    "uniform float material_shininess;\n"
+    "varying vec4 color;\n"
+    "void main() {\n"
+    "    vec4 eye = gl_ModelViewMatrix * gl_Vertex;\n"
+    "    vec3 normal = normalize(gl_NormalMatrix * gl_Normal);\n"
+    "    vec3 to_light = normalize(light_position.xyz - eye.xyz);\n"
+    "    vec3 to_eye = normalize(-eye.xyz);\n"
+    "    float diffuse = max(dot(normal, to_light), 0.0);\n"
+    "    float specular = 0.0;\n"
+    "    if(diffuse > 0.0) {\n"
+    "        specular = pow(max(dot(normal, normalize(to_light + to_eye)), 0.0),\n"
+    "                       material_shininess);\n"
+    "    }\n"
+    "    color = material_ambient * (light_ambient + vec4(0.2, 0.2, 0.2, 1.0))\n"
+    "          + material_diffuse * light_diffuse * diffuse\n"
+    "          + material_specular * light_specular * specular;\n"
+    "    color.a = material_diffuse.a;\n"
+    "    gl_Position = projection * eye;\n"
+    "}\n";
+
+static const char* lit_fragment_source =
+    "#version 120\n"
+    "varying vec4 color;\n"
+    "void main() {\n"
+    "    gl_FragColor = color;\n"
+    "}\n";
+
+// Compiles one shader stage. Returns 0 and prints the info log if the
+// source does not compile.
+GLuint compile_shader(GLenum type, const char* source) {
+    GLuint shader = glCreateShader(type);
+    GLint status;
+
+    glShaderSource(shader, 1, &source, NULL);
+    glCompileShader(shader);
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
+    if(!status) {
+        char log[1024];
+        glGetShaderInfoLog(shader, sizeof(log), NULL, log);
+        fprintf(stderr, "shader compile failed: %s\n", log);
+        glDeleteShader(shader);
+        return 0;
+    }
+    return shader;
+}
+
+// Used as a constructor to build the lit shader program. Returns NULL
+// if the context does not support GLSL 1.20 or the program fails to
+// build.
+LitShader* make_lit_shader(MemTag tag) {
+    const char* version = (const char*)glGetString(GL_SHADING_LANGUAGE_VERSION);
+    GLuint vertex, fragment;
+    GLint status;
+    LitShader* shader;
+
+    if(version == NULL || atof(version) < 1.2) {
+        return NULL;
+    }
+
+    vertex   = compile_shader(GL_VERTEX_SHADER, lit_vertex_source);
+    fragment = compile_shader(GL_FRAGMENT_SHADER, lit_fragment_source);
+    if(vertex == 0 || fragment == 0) {
+        glDeleteShader(vertex);
+        glDeleteShader(fragment);
+        return NULL;
+    }
+
+    shader = tracked_malloc(sizeof(LitShader), tag);
+    shader->program = glCreateProgram();
+    glAttachShader(shader->program, vertex);
+    glAttachShader(shader->program, fragment);
+    glLinkProgram(shader->program);
+    glDeleteShader(vertex);
+    glDeleteShader(fragment);
+
+    glGetProgramiv(shader->program, GL_LINK_STATUS, &status);
+    if(!status) {
+        char log[1024];
+        glGetProgramInfoLog(shader->program, sizeof(log), NULL, log);
+        fprintf(stderr, "shader link failed: %s\n", log);
+        glDeleteProgram(shader->program);
+        tracked_free(shader);
+        return NULL;
+    }
+
+    shader->projection         = glGetUniformLocation(shader->program, "projection");
+    shader->light_position     = glGetUniformLocation(shader->program, "light_position");
+    shader->light_ambient      = glGetUniformLocation(shader->program, "light_ambient");
+    shader->light_diffuse      = glGetUniformLocation(shader->program, "light_diffuse");
+    shader->light_specular     = glGetUniformLocation(shader->program, "light_specular");
+    shader->material_ambient   = glGetUniformLocation(shader->program, "material_ambient");
+    shader->material_diffuse   = glGetUniformLocation(shader->program, "material_diffuse");
+    shader->material_specular  = glGetUniformLocation(shader->program, "material_specular");
+    shader->material_shininess = glGetUniformLocation(shader->program, "material_shininess");
+    return shader;
+}
+
+// Frees a LitShader object created by make_lit_shader().
+void destroy_lit_shader(LitShader* shader) {
+    glDeleteProgram(shader->program);
+    tracked_free(shader);
+}
+
+// Sets the light uniforms. The position is given in eye coordinates.
+void lit_shader_set_light(LitShader* shader, const GLfloat* position,
+                          const GLfloat* ambient, const GLfloat* diffuse,
+                          const GLfloat* specular) {
+    glUseProgram(shader->program);
+    glUniform4fv(shader->light_position, 1, position);
+    glUniform4fv(shader->light_ambient, 1, ambient);
+    glUniform4fv(shader->light_diffuse, 1, diffuse);
+    glUniform4fv(shader->light_specular, 1, specular);
+}
+
+// Sets the projection uniform from a column-major 4x4 matrix.
+void lit_shader_set_projection(LitShader* shader, const GLfloat* matrix) {
+    glUseProgram(shader->program);
+    glUniformMatrix4fv(shader->projection, 1, GL_FALSE, matrix);
+}
+
+// Sets the material uniforms. The program must be in use.
+void lit_shader_set_material(LitShader* shader, const Material* material) {
+    glUniform4fv(shader->material_ambient, 1, material->ambient);
+    glUniform4fv(shader->material_diffuse, 1, material->diffuse);
+    glUniform4fv(shader->material_specular, 1, material->specular);
+    glUniform1f(shader->material_shininess, material->shininess);
+}
+
+#endif
@@ -0,0 +1,67 @@
+/*********************************************************************
+
+    Soak test driver for the blaster game.
+
+    This program runs the game headless (without a window or GLUT)
+    on a simulated clock. A simple autopilot steers the player under
+    each enemy and fires the laser until the requested number of kills
+    has been reached. The tracked allocator's live byte count is
+    sampled after the first kill and must be the same after the last
+    kill; any growth makes the program exit with a failure status.
+
+    Usage: soak [kills]        (default 1000 kills)
+
+ ********************************************************************/
+#define BLASTER_HEADLESS
+#include "blaster.c"
+
+int main(int argc, char** argv) {
+    int target_kills = 1000;
+    size_t baseline_bytes = 0;
+    long baseline_allocs = 0;
+    long frames = 0;
+
+    if(argc > 1) {
+        target_kills = atoi(argv[1]);
+    }
+
+    target_frame_rate = 30;
+    init();
+    spawn_enemy();
+
+    while(player_score < target_kills && !is_game_over) {
+        int score_before = player_score;
+
+        headless_tick();
+        frames++;
+
+        if(score_before == 0 && player_score == 1) {
+            baseline_bytes  = mem_total_live_bytes;
+            baseline_allocs = mem_live_allocs;
+        }
+    }
+
+    printf("kills: %d  frames: %ld  simulated time: %.1f s\n",
+           player_score, frames, sim_time / 1000.0);
+    mem_report(stdout);
+
+    if(is_game_over) {
+        printf("FAIL: game over before reaching %d kills\n", target_kills);
+        return 1;
+    }
+    if(mem_total_live_bytes != baseline_bytes || mem_live_allocs != baseline_allocs) {
+        printf("FAIL: live memory grew from %zu B (%ld allocations) to %zu B (%ld allocations)\n",
+               baseline_bytes, baseline_allocs, mem_total_live_bytes, mem_live_allocs);
+        return 1;
+    }
+
+    cleanup();
+    if(mem_total_live_bytes != 0 || mem_live_allocs != 0) {
+        printf("FAIL: %zu B in %ld allocations still live after cleanup\n",
+               mem_total_live_bytes, mem_live_allocs);
+        return 1;
+    }
+
+    printf("PASS: no memory growth over %d kills\n", target_kills);
+    return 0;
+}
@@ -0,0 +1,131 @@
+/*********************************************************************
+
+    Equivalence test for the batch collision kernel.
+
+    This program checks that collide_boxes() produces the same masks
+    as the scalar reference collide_boxes_scalar(). Every box count
+    from 0 to 67 is tested, so the SIMD body runs with every possible
+    number of boxes left over for the scalar tail (counts that are not
+    a multiple of 4 for SSE2 or of 8 for AVX2). Half of the trials use
+    whole-number coordinates, which puts box edges exactly on laser
+    columns, the player box, and the bottom edge, so the strict
+    comparisons are tested at the boundaries as well.
+
+    The kernel that is tested is the one the compiler targets; the
+    build compiles this program once for the default target and once
+    with AVX2. An AVX2 build exits with status 77 (skipped) on a
+    processor without AVX2.
+
+    Usage: test_collision [trials]        (default 200 trials per count)
+
+ ********************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include "collision.h"
+
+#define MAX_BOXES 67
+#define LASER_COUNT 4
+#define SKIP_STATUS 77
+
+// Returns a random float in [low, high). When whole is set the result
+// is rounded to a whole number.
+float random_coordinate(float low, float high, int whole) {
+    float value = low + (high - low) * (rand() / (RAND_MAX + 1.0f));
+    return whole ? floorf(value) : value;
+}
+
+// Fills the set with count random boxes and the query with random
+// shapes on a 400 x 600 playfield.
+void fill_random(BoxSet* set, int count, CollisionQuery* query, int whole) {
+    int i;
+
+    box_set_clear(set);
+    for(i = 0; i < count; i++) {
+        box_set_add(set, random_coordinate(-200.0, 200.0, whole),
+                    random_coordinate(-300.0, 300.0, whole),
+                    2 * random_coordinate(1.0, 20.0, whole));
+    }
+    for(i = 0; i < LASER_COUNT; i++) {
+        query->laser_x[i] = random_coordinate(-200.0, 200.0, whole);
+    }
+    query->laser_count      = rand() % (LASER_COUNT + 1);
+    query->player_x         = random_coordinate(-200.0, 200.0, whole);
+    query->player_y         = random_coordinate(-300.0, 300.0, whole);
+    query->player_half_size = 12.5;
+    query->bottom_y         = random_coordinate(-300.0, 300.0, whole);
+}
+
+// Returns the number of boxes whose masks differ, printing the first
+// difference found.
+int compare_masks(const BoxSet* set, const CollisionMasks* expected,
+                  const CollisionMasks* actual) {
+    int mismatches = 0;
+    int i;
+
+    for(i = 0; i < set->count; i++) {
+        if(expected->laser[i]  != actual->laser[i] ||
+           expected->player[i] != actual->player[i] ||
+           expected->bottom[i] != actual->bottom[i]) {
+            if(mismatches == 0) {
+                printf("box %d of %d: expected laser %d player %d bottom %d, "
+                       "got laser %d player %d bottom %d\n", i, set->count,
+                       expected->laser[i], expected->player[i], expected->bottom[i],
+                       actual->laser[i], actual->player[i], actual->bottom[i]);
+            }
+            mismatches++;
+        }
+    }
+    return mismatches;
+}
+
+int main(int argc, char** argv) {
+    int trials = 200;
+    BoxSet* set = make_box_set(MAX_BOXES, MEM_ENTITIES);
+    CollisionMasks expected = make_collision_masks(MAX_BOXES, MEM_ENTITIES);
+    CollisionMasks actual   = make_collision_masks(MAX_BOXES, MEM_ENTITIES);
+    CollisionQuery query;
+    int mismatches = 0;
+    int count, trial;
+
+#if defined(__AVX2__) && defined(__GNUC__)
+    if(!__builtin_cpu_supports("avx2")) {
+        printf("SKIP: processor does not support AVX2\n");
+        return SKIP_STATUS;
+    }
+#endif
+#if defined(__AVX2__)
+    printf("kernel: AVX2 (8 boxes per iteration)\n");
+#elif defined(__SSE2__)
+    printf("kernel: SSE2 (4 boxes per iteration)\n");
+#else
+    printf("kernel: scalar\n");
+#endif
+
+    if(argc > 1) {
+        trials = atoi(argv[1]);
+    }
+    query.laser_x = tracked_malloc(LASER_COUNT * sizeof(float), MEM_ENTITIES);
+    srand(445);
+
+    for(count = 0; count <= MAX_BOXES; count++) {
+        for(trial = 0; trial < trials; trial++) {
+            fill_random(set, count, &query, trial % 2);
+            collide_boxes_scalar(set, &query, &expected);
+            collide_boxes(set, &query, &actual);
+            mismatches += compare_masks(set, &expected, &actual);
+        }
+    }
+
+    tracked_free(query.laser_x);
+    destroy_collision_masks(&expected);
+    destroy_collision_masks(&actual);
+    destroy_box_set(set);
+
+    if(mismatches != 0) {
+        printf("FAIL: %d boxes differ from the scalar reference\n", mismatches);
+        return 1;
+    }
+    printf("PASS: %d trials for each of 0 to %d boxes match the scalar reference\n",
+           trials, MAX_BOXES);
+    return 0;
+}
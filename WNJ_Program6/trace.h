@@ -0,0 +1,248 @@
+/***********************************************************
+
+   This header file contains the opt-in tracer used to look at the
+timeline of the game loop. TRACE_BEGIN() and TRACE_END() record begin
+and end events with a timestamp and thread ID. trace_stop(), or the
+exit handler if the program ends first, writes every recorded event
+as a Chrome trace-event JSON file, which can be opened in
+chrome://tracing or ui.perfetto.dev.
+
+   Each thread records into its own buffer, claimed from a pool the
+first time the thread records an event, so recording takes no locks.
+A buffer's event count is published with a release store, so the
+writer only ever sees complete events. Room for the end event of every
+recorded begin event is kept in reserve, so when a buffer fills up
+whole begin/end pairs are dropped and the trace stays balanced.
+
+   Tracing is off unless the game is built with BLASTER_TRACE defined
+and trace_start() is called. Without BLASTER_TRACE the macros expand
+to nothing; with it, a disabled tracer costs one predictable branch
+per event.
+
+ ************************************************************/
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "mem_track.h"
+#include "frame_pacer.h"
+
+// Number of threads that can record events, and the number of events
+// each thread's buffer holds (about 3 MB per thread).
+#define TRACE_MAX_THREADS 4
+#define TRACE_BUFFER_EVENTS (1 << 17)
+
+// Represents one begin ('B') or end ('E') event. The name must be a
+// string literal, since only the pointer is stored.
+typedef struct {
+    const char* name;
+    double timestamp;
+    char phase;
+} TraceEvent;
+
+// Represents the events recorded by one thread.
+//      - open is the number of recorded begin events still waiting for
+//        their end events.
+//      - skipped is the number of dropped begin events still waiting
+//        for their end events, which are dropped too.
+typedef struct {
+    TraceEvent* events;
+    int count;
+    int open;
+    int skipped;
+    long dropped;
+    const char* thread_name;
+} TraceBuffer;
+
+// A boolean integer used to determine if events are being recorded.
+int trace_enabled;
+
+#ifdef BLASTER_TRACE
+
+#define TRACE_BEGIN(name) do { if(trace_enabled) trace_event(name, 'B'); } while(0)
+#define TRACE_END(name)   do { if(trace_enabled) trace_event(name, 'E'); } while(0)
+
+TraceBuffer trace_buffers[TRACE_MAX_THREADS];
+int trace_thread_count;
+double trace_start_time;
+char* trace_path;
+
+// The buffer claimed by the calling thread, or NULL before its first
+// event. A thread that finds the pool empty records nothing.
+__thread TraceBuffer* trace_local;
+__thread int trace_local_claimed;
+
+// Returns the calling thread's buffer, claiming one from the pool on
+// the first call.
+TraceBuffer* trace_thread_buffer() {
+    if(!trace_local_claimed) {
+        int index = __atomic_fetch_add(&trace_thread_count, 1, __ATOMIC_RELAXED);
+        trace_local_claimed = 1;
+        trace_local = index < TRACE_MAX_THREADS ? &trace_buffers[index] : NULL;
+    }
+    return trace_local;
+}
+
+// Records an event on the calling thread's buffer. A begin event is
+// only recorded if there is also room left for its end event and for
+// the end events of every scope still open; otherwise it is dropped
+// along with its end event. Scopes nest, so once begin events start
+// being dropped, every later one is dropped too, and the next end
+// events belong to the dropped ones. An end event with no begin event,
+// such as one for a scope entered before tracing started, is dropped.
+void trace_event(const char* name, char phase) {
+    TraceBuffer* buffer = trace_thread_buffer();
+    TraceEvent* event;
+
+    if(buffer == NULL) {
+        return;
+    }
+    if(phase == 'B') {
+        if(buffer->skipped > 0 || buffer->count + buffer->open + 2 > TRACE_BUFFER_EVENTS) {
+            buffer->skipped++;
+            buffer->dropped++;
+            return;
+        }
+        buffer->open++;
+    }
+    else if(buffer->skipped > 0) {
+        buffer->skipped--;
+        buffer->dropped++;
+        return;
+    }
+    else if(buffer->open == 0) {
+        buffer->dropped++;
+        return;
+    }
+    else {
+        buffer->open--;
+    }
+    event = &buffer->events[buffer->count];
+    event->name      = name;
+    event->timestamp = pacer_now();
+    event->phase     = phase;
+    __atomic_store_n(&buffer->count, buffer->count + 1, __ATOMIC_RELEASE);
+}
+
+// Names the calling thread in the trace.
+void trace_set_thread_name(const char* name) {
+    TraceBuffer* buffer;
+
+    if(!trace_enabled) {
+        return;
+    }
+    buffer = trace_thread_buffer();
+    if(buffer != NULL) {
+        buffer->thread_name = name;
+    }
+}
+
+// Writes every recorded event to the trace file.
+void trace_write() {
+    int threads = trace_thread_count < TRACE_MAX_THREADS ? trace_thread_count : TRACE_MAX_THREADS;
+    long dropped = 0;
+    FILE* file = fopen(trace_path, "w");
+    int i, j;
+
+    if(file == NULL) {
+        perror(trace_path);
+        return;
+    }
+
+    fputs("{\"traceEvents\":[\n", file);
+    for(i = 0; i < threads; i++) {
+        TraceBuffer* buffer = &trace_buffers[i];
+        int count = __atomic_load_n(&buffer->count, __ATOMIC_ACQUIRE);
+
+        fprintf(file, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,"
+                      "\"args\":{\"name\":\"%s\"}},\n",
+                i + 1, buffer->thread_name != NULL ? buffer->thread_name : "thread");
+        for(j = 0; j < count; j++) {
+            TraceEvent* event = &buffer->events[j];
+            fprintf(file, "{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%.3f,\"pid\":1,\"tid\":%d},\n",
+                    event->name, event->phase,
+                    (event->timestamp - trace_start_time) * 1e6, i + 1);
+        }
+        dropped += buffer->dropped;
+    }
+    fprintf(file, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,"
+                  "\"args\":{\"name\":\"blaster\"}}\n");
+    fprintf(file, "],\"displayTimeUnit\":\"ms\",\"otherData\":{\"dropped_events\":%ld}}\n",
+            dropped);
+    fclose(file);
+    printf("trace: wrote %s (%ld events dropped)\n", trace_path, dropped);
+}
+
+// Stops recording, writes the trace file, and frees the buffers. Any
+// other thread that records events must have finished first. Does
+// nothing if tracing is not running.
+void trace_stop() {
+    int i;
+
+    if(!trace_enabled) {
+        return;
+    }
+    trace_enabled = 0;
+    trace_write();
+
+    for(i = 0; i < TRACE_MAX_THREADS; i++) {
+        tracked_free(trace_buffers[i].events);
+        trace_buffers[i].events = NULL;
+    }
+    tracked_free(trace_path);
+    trace_path = NULL;
+}
+
+// Exit handler for programs that end without calling trace_stop(),
+// such as when the window is closed. Other threads may still be
+// running, so the buffers are written but not freed.
+void trace_exit_handler() {
+    if(trace_enabled) {
+        trace_enabled = 0;
+        trace_write();
+    }
+}
+
+// Starts recording events, to be written to path by trace_stop() or at
+// exit. The buffers are allocated here, on the calling thread, so the
+// tracked allocator is only used from one thread.
+void trace_start(const char* path) {
+    int i;
+
+    for(i = 0; i < TRACE_MAX_THREADS; i++) {
+        trace_buffers[i].events = tracked_malloc(TRACE_BUFFER_EVENTS * sizeof(TraceEvent),
+                                                 MEM_TRACE);
+        trace_buffers[i].count   = 0;
+        trace_buffers[i].open    = 0;
+        trace_buffers[i].skipped = 0;
+        trace_buffers[i].dropped = 0;
+        trace_buffers[i].thread_name = NULL;
+    }
+    trace_path = tracked_malloc(strlen(path) + 1, MEM_TRACE);
+    strcpy(trace_path, path);
+    trace_start_time = pacer_now();
+    trace_enabled = 1;
+    trace_set_thread_name("main");
+    atexit(trace_exit_handler);
+}
+
+#else
+
+#define TRACE_BEGIN(name) do { } while(0)
+#define TRACE_END(name)   do { } while(0)
+
+void trace_set_thread_name(const char* name) {
+}
+
+void trace_start(const char* path) {
+    fprintf(stderr, "tracing is not compiled in; rebuild with BLASTER_TRACE\n");
+}
+
+void trace_stop() {
+}
+
+#endif
+
+#endif
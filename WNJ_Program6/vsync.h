@@ -0,0 +1,121 @@
+/***********************************************************
+
+   This header file contains the display synchronization helpers used
+when the game starts. The swap interval decides whether
+glutSwapBuffers() waits for the display's vertical refresh. The game
+turns that wait off when the frame rate is uncapped. When the frame rate
+is capped it turns the wait on and measures the refresh period, so a
+requested rate the display cannot reach can be lowered to one it can.
+
+   The swap interval is set through GLX on Linux and CGL on macOS.
+Drivers may ignore the request or force their own setting, so the
+measured refresh period is what the game relies on.
+
+ ************************************************************/
+#ifndef VSYNC_H
+#define VSYNC_H
+
+#include <stdlib.h>
+#ifdef __APPLE__
+#  include <GLUT/glut.h>
+#  include <OpenGL/OpenGL.h>
+#else
+#  include <GL/glut.h>
+#  include <GL/glx.h>
+#endif
+#include "frame_pacer.h"
+
+// Number of swaps timed when measuring the refresh period; the first
+// few are not counted, since they can return before the window is
+// fully on screen.
+#define VSYNC_MEASURE_FRAMES 16
+#define VSYNC_WARMUP_FRAMES 4
+
+// Swap intervals shorter than this are taken to mean that swaps do not
+// wait for the display at all.
+#define VSYNC_MIN_PERIOD 0.002
+
+// Sets the number of vertical refreshes glutSwapBuffers() waits for:
+// 0 to not wait, 1 to wait for the next refresh. Must be called with
+// the window's context current. Returns 1 if the setting was accepted
+// and 0 if the platform offers no way to set it.
+int set_swap_interval(int interval) {
+#ifdef __APPLE__
+    GLint value = interval;
+    CGLContextObj context = CGLGetCurrentContext();
+
+    return context != NULL &&
+           CGLSetParameter(context, kCGLCPSwapInterval, &value) == kCGLNoError;
+#else
+    typedef void (*SwapIntervalEXT)(Display*, GLXDrawable, int);
+    typedef int (*SwapIntervalMESA)(unsigned int);
+    typedef int (*SwapIntervalSGI)(int);
+    Display* display = glXGetCurrentDisplay();
+    GLXDrawable drawable = glXGetCurrentDrawable();
+    SwapIntervalEXT swap_interval_ext;
+    SwapIntervalMESA swap_interval_mesa;
+    SwapIntervalSGI swap_interval_sgi;
+
+    if(display == NULL || drawable == 0) {
+        return 0;
+    }
+    swap_interval_ext = (SwapIntervalEXT)glXGetProcAddressARB(
+        (const GLubyte*)"glXSwapIntervalEXT");
+    if(swap_interval_ext != NULL) {
+        swap_interval_ext(display, drawable, interval);
+        return 1;
+    }
+    swap_interval_mesa = (SwapIntervalMESA)glXGetProcAddressARB(
+        (const GLubyte*)"glXSwapIntervalMESA");
+    if(swap_interval_mesa != NULL) {
+        return swap_interval_mesa(interval) == 0;
+    }
+    // The SGI extension cannot turn the wait off.
+    swap_interval_sgi = (SwapIntervalSGI)glXGetProcAddressARB(
+        (const GLubyte*)"glXSwapIntervalSGI");
+    if(swap_interval_sgi != NULL && interval > 0) {
+        return swap_interval_sgi(interval) == 0;
+    }
+    return 0;
+#endif
+}
+
+// Compares two doubles for qsort().
+int compare_doubles(const void* a, const void* b) {
+    double difference = *(const double*)a - *(const double*)b;
+    return (difference > 0.0) - (difference < 0.0);
+}
+
+// Measures how long glutSwapBuffers() takes to return from one swap to
+// the next when nothing else is done between swaps, which is the
+// refresh period when swaps wait for the display. If drawing a frame
+// takes longer than that, the drawing time is measured instead, which
+// is just as much a rate the game cannot exceed. draw is called
+// before every swap so the window shows a real frame. Returns the
+// median interval in seconds, or 0 if swaps do not wait for the
+// display.
+double measure_refresh_period(void (*draw)(void)) {
+    double intervals[VSYNC_MEASURE_FRAMES - VSYNC_WARMUP_FRAMES];
+    double last_swap = 0.0;
+    double period;
+    int i;
+
+    for(i = 0; i < VSYNC_MEASURE_FRAMES; i++) {
+        double now;
+
+        draw();
+        glutSwapBuffers();
+        glFinish();
+        now = pacer_now();
+        if(i >= VSYNC_WARMUP_FRAMES) {
+            intervals[i - VSYNC_WARMUP_FRAMES] = now - last_swap;
+        }
+        last_swap = now;
+    }
+    qsort(intervals, VSYNC_MEASURE_FRAMES - VSYNC_WARMUP_FRAMES, sizeof(double),
+          compare_doubles);
+    period = intervals[(VSYNC_MEASURE_FRAMES - VSYNC_WARMUP_FRAMES) / 2];
+    return period >= VSYNC_MIN_PERIOD ? period : 0.0;
+}
+
+#endif